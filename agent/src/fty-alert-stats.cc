@@ -69,6 +69,14 @@ int main (int argc, char *argv [])
     const char * metricTTL = "720"; // sec.
     const char * tickPeriod = "180"; // sec.
     const char * resyncPeriod = "43200"; // sec.
+    const char * publishLatency = "1000"; // msec.
+    const char * streamBatch = "256";
+    const char * streamBatchBudget = "50"; // msec.
+    const char * assetQueryBatch = "1";
+    const char * assetQueryWindow = "256";
+    const char * publishPrefixes = "datacenter-,room-,row-,rack-";
+    const char * publishTypes = "";
+    AlertMetrics metrics = defaultAlertMetrics ();
 
     ftylog_setInstance("fty-alert-stats", FTY_COMMON_LOGGING_DEFAULT_CFG);
 
@@ -113,6 +121,34 @@ int main (int argc, char *argv [])
             metricTTL = zconfig_get(config, "agent/metric_ttl", metricTTL);
             tickPeriod = zconfig_get(config, "agent/tick_period", tickPeriod);
             resyncPeriod = zconfig_get(config, "agent/resync_period", resyncPeriod);
+            publishLatency = zconfig_get(config, "agent/publish_latency", publishLatency);
+            streamBatch = zconfig_get(config, "agent/stream_batch", streamBatch);
+            streamBatchBudget = zconfig_get(config, "agent/stream_batch_budget", streamBatchBudget);
+            assetQueryBatch = zconfig_get(config, "agent/asset_query_batch", assetQueryBatch);
+            assetQueryWindow = zconfig_get(config, "agent/asset_query_window", assetQueryWindow);
+            publishPrefixes = zconfig_get(config, "agent/publish_prefixes", publishPrefixes);
+            publishTypes = zconfig_get(config, "agent/publish_types", publishTypes);
+
+            // Published metrics, each one summing a list of alert categories
+            zconfig_t *metricsConfig = zconfig_locate(config, "metrics");
+            if (metricsConfig && zconfig_child(metricsConfig)) {
+                metrics.clear();
+                for (zconfig_t *item = zconfig_child(metricsConfig); item; item = zconfig_next(item)) {
+                    const char *value = zconfig_value(item);
+                    AlertMetric metric;
+                    if (parseAlertMetric(zconfig_name(item), value ? value : "", metric)) {
+                        metrics.push_back(metric);
+                    }
+                    else {
+                        log_error ("Invalid metric '%s' (categories '%s'), ignored.",
+                            zconfig_name(item), value ? value : "");
+                    }
+                }
+                if (metrics.empty()) {
+                    log_error ("No valid metric configured, publishing default metrics.");
+                    metrics = defaultAlertMetrics ();
+                }
+            }
             //log_info ("Config file loaded (%s)", CONFIGFILE);
         }
         else {
@@ -135,6 +171,14 @@ int main (int argc, char *argv [])
     params.endpoint = "ipc://@/malamute";
     params.metricTTL = std::stol(metricTTL);
     params.pollerTimeout = std::stol(tickPeriod) * 1000;
+    params.publishLatency = std::stol(publishLatency);
+    params.streamBatch = std::stol(streamBatch);
+    params.streamBatchBudget = std::stol(streamBatchBudget);
+    params.assetQueryBatch = std::stol(assetQueryBatch);
+    params.assetQueryWindow = std::stol(assetQueryWindow);
+    params.metrics = metrics;
+    params.publishPrefixes = AssetClassifier::parseList(publishPrefixes);
+    params.publishTypes = AssetClassifier::parseList(publishTypes);
     alert_stats_server = zactor_new (fty_alert_stats_server, reinterpret_cast<void*>(&params));
     if (!alert_stats_server) {
         log_fatal("alert_stats_server creation failed");
@@ -0,0 +1,262 @@
+/*  ========================================================================
+    Copyright (C) 2020 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+
+
+#include "bench.h"
+#include "src/fty_alert_stats_actor.h"
+#include "src/fty_alert_stats_server.h"
+#include <catch2/catch.hpp>
+#include <czmq.h>
+#include <fty_proto.h>
+#include <fty_shm.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Drives the hot paths of AlertStatsActor directly, without going through
+/// the mailbox or the streams.
+class AlertStatsActorBench
+{
+public:
+    AlertStatsActorBench(const char* endpoint, const BenchTopology& shape)
+    {
+        AlertStatsActorParams params;
+        params.endpoint      = endpoint;
+        params.metricTTL     = 720;
+        params.pollerTimeout = 30 * 1000;
+
+        m_pipe = zsys_create_pipe(&m_peer);
+        m_actor.reset(new AlertStatsActor(m_pipe, params));
+
+        m_levels.resize(size_t(shape.depth) + 1);
+        addAssets("datacenter-0", "", 0, shape);
+        flushMetrics();
+    }
+
+    ~AlertStatsActorBench()
+    {
+        m_actor.reset();
+        zsock_destroy(&m_pipe);
+        zsock_destroy(&m_peer);
+    }
+
+    /// Names of the assets at each level of the topology (0 is the datacenter).
+    const std::vector<std::vector<std::string>>& levels() const
+    {
+        return m_levels;
+    }
+
+    const std::vector<std::string>& leaves() const
+    {
+        return m_levels.back();
+    }
+
+    static fty_proto_t* asset(const std::string& name, const std::string& parent, const char* operation)
+    {
+        fty_proto_t* asset = fty_proto_new(FTY_PROTO_ASSET);
+        fty_proto_set_name(asset, "%s", name.c_str());
+        fty_proto_set_operation(asset, "%s", operation);
+        if (!parent.empty()) {
+            fty_proto_aux_insert(asset, FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "%s", parent.c_str());
+        }
+        return asset;
+    }
+
+    static fty_proto_t* alert(
+        const std::string& rule, const std::string& name, const char* state, uint64_t time, uint32_t ttl = 3600)
+    {
+        fty_proto_t* alert = fty_proto_new(FTY_PROTO_ALERT);
+        fty_proto_set_rule(alert, "%s", rule.c_str());
+        fty_proto_set_name(alert, "%s", name.c_str());
+        fty_proto_set_state(alert, "%s", state);
+        fty_proto_set_severity(alert, "%s", "WARNING");
+        fty_proto_set_time(alert, time);
+        fty_proto_set_ttl(alert, ttl);
+        return alert;
+    }
+
+    void processAsset(fty_proto_t* asset)
+    {
+        m_actor->processAsset(asset);
+    }
+
+    void processAlert(fty_proto_t* alert)
+    {
+        m_actor->processAlert(alert);
+    }
+
+    void flushMetrics()
+    {
+        m_actor->flushMetrics(true);
+    }
+
+    void recomputeAlerts()
+    {
+        m_actor->recomputeAlerts();
+    }
+
+    void tick()
+    {
+        m_actor->tick();
+    }
+
+    void purgeExpiredAlerts()
+    {
+        m_actor->purgeExpiredAlerts();
+    }
+
+private:
+    void addAssets(const std::string& name, const std::string& parent, int level, const BenchTopology& shape)
+    {
+        static const char* prefixes[] = {"datacenter", "room", "row", "rack"};
+
+        processAsset(asset(name, parent, FTY_PROTO_ASSET_OP_CREATE));
+        m_levels[size_t(level)].push_back(name);
+
+        if (level < shape.depth) {
+            const char*       prefix = level + 1 < 4 ? prefixes[level + 1] : "device";
+            const std::string path   = level == 0 ? "" : name.substr(name.find('-'));
+
+            for (int i = 0; i < shape.width; i++) {
+                addAssets(prefix + path + "-" + std::to_string(i), name, level + 1, shape);
+            }
+        }
+    }
+
+    zsock_t*                              m_pipe = nullptr;
+    zsock_t*                              m_peer = nullptr;
+    std::unique_ptr<AlertStatsActor>      m_actor;
+    std::vector<std::vector<std::string>> m_levels;
+};
+
+TEST_CASE("actor hot paths")
+{
+    const char*          endpoint = "inproc://fty-alert-stats-bench";
+    const BenchTopology& shape    = benchTopology();
+
+    fty_shm_set_test_dir(".");
+
+    zactor_t* server = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    REQUIRE(server);
+    zstr_sendx(server, "BIND", endpoint, NULL);
+
+    {
+        AlertStatsActorBench            bench(endpoint, shape);
+        const std::vector<std::string>& leaves = bench.leaves();
+        const uint64_t                  now    = uint64_t(zclock_time() / 1000);
+
+        size_t assets = 0;
+        for (const auto& level : bench.levels()) {
+            assets += level.size();
+        }
+        WARN("Topology of " << assets << " assets (width " << shape.width << ", depth " << shape.depth << "), "
+                            << leaves.size() << " leaves.");
+
+        // One active alert per leaf
+        std::vector<bool> active(leaves.size(), true);
+        for (const std::string& leaf : leaves) {
+            bench.processAlert(AlertStatsActorBench::alert("alert@" + leaf, leaf, "ACTIVE", now));
+        }
+        bench.flushMetrics();
+
+        // Toggle alerts of the leaves in turn
+        size_t cursor       = 0;
+        auto   flappingRuns = [&](int runs) {
+            std::vector<fty_proto_t*> alerts;
+            for (int i = 0; i < runs; i++, cursor++) {
+                const size_t       leaf  = cursor % leaves.size();
+                const std::string& name  = leaves[leaf];
+                active[leaf]             = !active[leaf];
+                alerts.push_back(
+                    AlertStatsActorBench::alert("alert@" + name, name, active[leaf] ? "ACTIVE" : "RESOLVED", now));
+            }
+            return alerts;
+        };
+
+        BENCHMARK_ADVANCED("alert flapping, ingest (callbackAlertPre)")(Catch::Benchmark::Chronometer meter)
+        {
+            std::vector<fty_proto_t*> alerts = flappingRuns(meter.runs());
+            meter.measure([&](int i) {
+                bench.processAlert(alerts[size_t(i)]);
+            });
+            bench.flushMetrics();
+        };
+
+        BENCHMARK_ADVANCED("alert flapping, ingest and publish")(Catch::Benchmark::Chronometer meter)
+        {
+            std::vector<fty_proto_t*> alerts = flappingRuns(meter.runs());
+            meter.measure([&](int i) {
+                bench.processAlert(alerts[size_t(i)]);
+                bench.flushMetrics();
+            });
+        };
+
+        // Move the first asset above the leaves back and forth between two parents
+        if (shape.depth >= 3 && shape.width >= 2) {
+            const auto&        levels     = bench.levels();
+            const std::string& moved      = levels[levels.size() - 2][0];
+            const std::string  parents[2] = {levels[levels.size() - 3][0], levels[levels.size() - 3][1]};
+            size_t             moves      = 0;
+
+            BENCHMARK_ADVANCED("subtree reparenting (callbackAssetPost)")(Catch::Benchmark::Chronometer meter)
+            {
+                std::vector<fty_proto_t*> assets;
+                for (int i = 0; i < meter.runs(); i++, moves++) {
+                    assets.push_back(
+                        AlertStatsActorBench::asset(moved, parents[(moves + 1) % 2], FTY_PROTO_ASSET_OP_UPDATE));
+                }
+                meter.measure([&](int i) {
+                    bench.processAsset(assets[size_t(i)]);
+                });
+                bench.flushMetrics();
+            };
+        }
+
+        BENCHMARK("recomputeAlerts")
+        {
+            bench.recomputeAlerts();
+        };
+
+        BENCHMARK("tick")
+        {
+            bench.tick();
+        };
+
+        const size_t expiring = std::min(leaves.size(), size_t(1000));
+
+        BENCHMARK_ADVANCED("expire " + std::to_string(expiring) + " alerts (ingest and purgeExpiredAlerts)")(
+            Catch::Benchmark::Chronometer meter)
+        {
+            std::vector<std::vector<fty_proto_t*>> alerts(size_t(meter.runs()));
+            for (auto& run : alerts) {
+                for (size_t i = 0; i < expiring; i++) {
+                    run.push_back(AlertStatsActorBench::alert("expired@" + leaves[i], leaves[i], "ACTIVE", 0, 0));
+                }
+            }
+            meter.measure([&](int i) {
+                for (fty_proto_t* alert : alerts[size_t(i)]) {
+                    bench.processAlert(alert);
+                }
+                bench.purgeExpiredAlerts();
+            });
+            bench.flushMetrics();
+        };
+    }
+
+    zactor_destroy(&server);
+
+    fty_shm_delete_test_dir();
+}
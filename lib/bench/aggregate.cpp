@@ -0,0 +1,200 @@
+/*  ========================================================================
+    Copyright (C) 2020 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+
+
+#include "bench.h"
+#include "src/fty_alert_stats_topology.h"
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Alert
+{
+    std::string       asset;
+    AssetTopology::Id id;
+    bool              critical;
+};
+
+/// 1 datacenter > 10 rooms > 10 rows each > 10 racks each > 99 devices each
+/// (about 100k assets), the given number of alerts per device.
+void buildDatacenter(AssetTopology& topology, std::vector<Alert>& alerts, int alertsPerDevice)
+{
+    AssetTopology::Id datacenter = topology.intern("datacenter-0");
+
+    for (int room = 0; room < 10; room++) {
+        std::string       roomName = "room-" + std::to_string(room);
+        AssetTopology::Id roomId   = topology.intern(roomName);
+        topology.setParent(roomId, datacenter);
+
+        for (int row = 0; row < 10; row++) {
+            std::string       rowName = "row-" + std::to_string(room) + "-" + std::to_string(row);
+            AssetTopology::Id rowId   = topology.intern(rowName);
+            topology.setParent(rowId, roomId);
+
+            for (int rack = 0; rack < 10; rack++) {
+                std::string       rackName = "rack-" + rowName.substr(4) + "-" + std::to_string(rack);
+                AssetTopology::Id rackId   = topology.intern(rackName);
+                topology.setParent(rackId, rowId);
+
+                for (int device = 0; device < 99; device++) {
+                    std::string       deviceName = "device-" + rackName.substr(5) + "-" + std::to_string(device);
+                    AssetTopology::Id deviceId   = topology.intern(deviceName);
+                    topology.setParent(deviceId, rackId);
+
+                    for (int alert = 0; alert < alertsPerDevice; alert++) {
+                        alerts.push_back({deviceName, deviceId, (device + alert) % 2 == 0});
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// Synthetic topology of the given shape, the given number of alerts per leaf.
+void buildSynthetic(AssetTopology& topology, std::vector<Alert>& alerts, const BenchTopology& shape, int alertsPerLeaf)
+{
+    std::vector<AssetTopology::Id> level = {topology.intern("datacenter-0")};
+
+    for (int depth = 0; depth < shape.depth; depth++) {
+        std::vector<AssetTopology::Id> children;
+        for (AssetTopology::Id parent : level) {
+            for (int i = 0; i < shape.width; i++) {
+                AssetTopology::Id child = topology.intern(topology.name(parent) + "-" + std::to_string(i));
+                topology.setParent(child, parent);
+                children.push_back(child);
+            }
+        }
+        level.swap(children);
+    }
+
+    for (AssetTopology::Id leaf : level) {
+        for (int alert = 0; alert < alertsPerLeaf; alert++) {
+            alerts.push_back({topology.name(leaf), leaf, (leaf + alert) % 2 == 0});
+        }
+    }
+}
+
+void clearCounts(AssetTopology& topology)
+{
+    for (AssetTopology::Id id = 0; id < topology.size(); id++) {
+        topology.counters(id) = AlertCounters();
+    }
+}
+
+/// Former approach, still used for incremental updates: add each alert to its
+/// asset and all of its ancestors, one counter at a time like recomputeAlert().
+template <bool Resolve>
+void walkAlerts(AssetTopology& topology, const std::vector<Alert>& alerts)
+{
+    clearCounts(topology);
+
+    for (const Alert& alert : alerts) {
+        const AlertCategory category = alert.critical ? AlertCategory::ACTIVE_CRITICAL : AlertCategory::ACTIVE_WARNING;
+
+        AssetTopology::Id cur = Resolve ? topology.intern(alert.asset) : alert.id;
+        while (cur != AssetTopology::NONE) {
+            topology.counters(cur)[category]++;
+            cur = topology.parent(cur);
+        }
+    }
+}
+
+/// Tally each alert on its asset only, then aggregate bottom-up.
+template <bool Resolve>
+void aggregateAlerts(AssetTopology& topology, const std::vector<Alert>& alerts)
+{
+    clearCounts(topology);
+
+    for (const Alert& alert : alerts) {
+        AlertCounters& counters = topology.counters(Resolve ? topology.intern(alert.asset) : alert.id);
+        counters[alert.critical ? AlertCategory::ACTIVE_CRITICAL : AlertCategory::ACTIVE_WARNING]++;
+    }
+
+    topology.aggregate();
+}
+
+/// Check that both approaches agree, then benchmark them.
+void benchmarkAggregation(AssetTopology& topology, const std::vector<Alert>& alerts, const std::string& suffix)
+{
+    walkAlerts<true>(topology, alerts);
+    std::vector<AlertCounters> walked;
+    for (AssetTopology::Id id = 0; id < topology.size(); id++) {
+        walked.push_back(topology.counters(id));
+    }
+
+    aggregateAlerts<true>(topology, alerts);
+    for (AssetTopology::Id id = 0; id < topology.size(); id++) {
+        REQUIRE(topology.counters(id) == walked[id]);
+    }
+
+    // Including the resolution of asset names, as done when recomputing all statistics
+    BENCHMARK("per-alert ancestor walk" + suffix)
+    {
+        walkAlerts<true>(topology, alerts);
+        return topology.counters(0)[AlertCategory::ACTIVE_WARNING];
+    };
+
+    BENCHMARK("bottom-up aggregation" + suffix)
+    {
+        aggregateAlerts<true>(topology, alerts);
+        return topology.counters(0)[AlertCategory::ACTIVE_WARNING];
+    };
+
+    // Propagation only
+    BENCHMARK("per-alert ancestor walk (resolved)" + suffix)
+    {
+        walkAlerts<false>(topology, alerts);
+        return topology.counters(0)[AlertCategory::ACTIVE_WARNING];
+    };
+
+    BENCHMARK("bottom-up aggregation (resolved)" + suffix)
+    {
+        aggregateAlerts<false>(topology, alerts);
+        return topology.counters(0)[AlertCategory::ACTIVE_WARNING];
+    };
+}
+
+} // namespace
+
+TEST_CASE("full aggregation of 100k assets")
+{
+    for (int alertsPerDevice : {1, 4}) {
+        AssetTopology      topology;
+        std::vector<Alert> alerts;
+        buildDatacenter(topology, alerts, alertsPerDevice);
+
+        benchmarkAggregation(topology, alerts, ", alerts per device: " + std::to_string(alertsPerDevice));
+        CHECK(topology.counters(0).sum(alertCategoryBit(AlertCategory::ACTIVE_WARNING) |
+                                       alertCategoryBit(AlertCategory::ACTIVE_CRITICAL)) == 99000 * alertsPerDevice);
+    }
+}
+
+TEST_CASE("full aggregation of the synthetic topology")
+{
+    const BenchTopology& shape = benchTopology();
+
+    for (int alertsPerLeaf : {1, 4}) {
+        AssetTopology      topology;
+        std::vector<Alert> alerts;
+        buildSynthetic(topology, alerts, shape, alertsPerLeaf);
+
+        WARN("Topology of " << topology.size() << " assets (width " << shape.width << ", depth " << shape.depth
+                            << "), " << alerts.size() << " alerts.");
+        benchmarkAggregation(topology, alerts, ", alerts per leaf: " + std::to_string(alertsPerLeaf));
+    }
+}
@@ -0,0 +1,30 @@
+/*  ========================================================================
+    Copyright (C) 2020 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+
+
+#pragma once
+
+/// Shape of the synthetic topologies used by the benchmarks, set from the
+/// command line (--width, --depth).
+struct BenchTopology
+{
+    /// Number of children of each non-leaf asset.
+    int width = 10;
+    /// Number of levels below the datacenter.
+    int depth = 4;
+};
+
+BenchTopology& benchTopology();
@@ -0,0 +1,361 @@
+/*  ========================================================================
+    Copyright (C) 2020 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+
+
+/*
+@header
+    fty-alert-stats-loadgen - Alert storm load generator
+@discuss
+    Starts a broker and the agent in-process, publishes a synthetic topology on
+    the ASSETS stream, then a flapping alert storm on the ALERTS stream at
+    increasing rates. For each rate, the end-to-end latency is measured with
+    probe alerts, from their publication to the update of their metric in shm.
+    The highest rate whose latency stays within bounds is reported as the
+    maximum sustained rate.
+@end
+*/
+
+#include "src/fty_alert_stats_actor.h"
+#include "src/fty_alert_stats_server.h"
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <czmq.h>
+#include <fty_log.h>
+#include <fty_proto.h>
+#include <fty_shm.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+static const char* ENDPOINT = "inproc://fty-alert-stats-loadgen";
+static const char* PROBE    = "rack-loadgen-probe";
+
+struct LoadgenOptions
+{
+    int     width        = 10;     // children per asset
+    int     depth        = 4;      // levels below the datacenter
+    int64_t rate         = 1000;   // alerts/sec. of the first step
+    int64_t maxRate      = 512000; // alerts/sec.
+    int64_t duration     = 5;      // sec. per step
+    int64_t latencyBound = 2000;   // msec.
+};
+
+/// Flapping alerts published on the leaves of the topology by a background
+/// thread, at a given rate.
+///
+/// Flapping is skewed like on real systems: 80% of the events hit 20% of the
+/// leaves. Each event raises a resolved alert (WARNING or CRITICAL), resolves
+/// an active alert or, sometimes, changes its severity.
+class AlertStorm
+{
+public:
+    AlertStorm(const std::vector<std::string>& leaves)
+        : m_leaves(leaves)
+        , m_states(leaves.size(), RESOLVED)
+        , m_random(42)
+    {
+        std::shuffle(m_leaves.begin(), m_leaves.end(), m_random);
+    }
+
+    void start(int64_t rate, int step)
+    {
+        m_rate   = rate;
+        m_sent   = 0;
+        m_stop   = false;
+        m_thread = std::thread(&AlertStorm::run, this, "loadgen-storm-" + std::to_string(step));
+    }
+
+    /// Stop publishing, return the number of alerts published.
+    int64_t stop()
+    {
+        m_stop = true;
+        m_thread.join();
+        return m_sent;
+    }
+
+private:
+    enum State : uint8_t
+    {
+        RESOLVED,
+        WARNING,
+        CRITICAL
+    };
+
+    void run(std::string name)
+    {
+        mlm_client_t* client = mlm_client_new();
+        if (mlm_client_connect(client, ENDPOINT, 1000, name.c_str()) != 0 ||
+            mlm_client_set_producer(client, FTY_PROTO_STREAM_ALERTS) != 0) {
+            log_error("Alert storm client couldn't connect.");
+            mlm_client_destroy(&client);
+            return;
+        }
+
+        // Catch up with the schedule every millisecond
+        const int64_t start = zclock_usecs();
+        while (!m_stop) {
+            const int64_t due = (zclock_usecs() - start) * m_rate / 1000000;
+
+            if (m_sent >= due) {
+                zclock_sleep(1);
+            }
+            while (m_sent < due && !m_stop) {
+                publish(client);
+                m_sent++;
+            }
+        }
+
+        mlm_client_destroy(&client);
+    }
+
+    void publish(mlm_client_t* client)
+    {
+        std::uniform_int_distribution<size_t> percent(0, 99);
+
+        const size_t hot   = std::max(size_t(1), m_leaves.size() / 5);
+        const size_t leaf  = percent(m_random) < 80 ? m_random() % hot : m_random() % m_leaves.size();
+        State&       state = m_states[leaf];
+
+        if (state == RESOLVED) {
+            state = percent(m_random) < 30 ? CRITICAL : WARNING;
+        } else if (percent(m_random) < 10) {
+            state = state == WARNING ? CRITICAL : WARNING;
+        } else {
+            state = RESOLVED;
+        }
+
+        const std::string& name = m_leaves[leaf];
+        zmsg_t*            msg  = fty_proto_encode_alert(nullptr, uint64_t(zclock_time() / 1000), 3600,
+            ("loadgen@" + name).c_str(), name.c_str(), state == RESOLVED ? "RESOLVED" : "ACTIVE",
+            state == CRITICAL ? "CRITICAL" : "WARNING", "", nullptr);
+        mlm_client_send(client, "alert", &msg);
+    }
+
+    std::vector<std::string> m_leaves;
+    std::vector<State>       m_states;
+    std::mt19937             m_random;
+    std::atomic<bool>        m_stop{false};
+    int64_t                  m_rate = 0;
+    std::atomic<int64_t>     m_sent{0};
+    std::thread              m_thread;
+};
+
+static void s_publishAsset(mlm_client_t* client, const std::string& name, const std::string& parent)
+{
+    zhash_t* aux = zhash_new();
+    zhash_t* ext = zhash_new();
+    if (!parent.empty()) {
+        zhash_insert(aux, FTY_PROTO_ASSET_AUX_PARENT_NAME_1, const_cast<char*>(parent.c_str()));
+    }
+
+    zmsg_t* msg = fty_proto_encode_asset(aux, name.c_str(), FTY_PROTO_ASSET_OP_CREATE, ext);
+    mlm_client_send(client, "asset", &msg);
+
+    zhash_destroy(&aux);
+    zhash_destroy(&ext);
+}
+
+/// Publish the topology (datacenter > rooms > rows > racks > devices...),
+/// collecting its leaves.
+static void s_publishTopology(mlm_client_t* client, const std::string& name, const std::string& parent, int level,
+    const LoadgenOptions& options, std::vector<std::string>& leaves)
+{
+    static const char* prefixes[] = {"datacenter", "room", "row", "rack"};
+
+    s_publishAsset(client, name, parent);
+
+    if (level == options.depth) {
+        leaves.push_back(name);
+        return;
+    }
+
+    const char*       prefix = level + 1 < 4 ? prefixes[level + 1] : "device";
+    const std::string path   = level == 0 ? "" : name.substr(name.find('-'));
+    for (int i = 0; i < options.width; i++) {
+        s_publishTopology(client, prefix + path + "-" + std::to_string(i), name, level + 1, options, leaves);
+    }
+}
+
+/// Wait for the warning metric of an asset to take a value, return the time
+/// waited in usecs. (or -1 on timeout).
+static int64_t s_waitMetric(const char* asset, const char* expected, int64_t start, int64_t timeout)
+{
+    std::string value;
+
+    while (zclock_usecs() - start < timeout * 1000) {
+        if (fty::shm::read_metric_value(asset, AlertStatsActor::WARNING_METRIC, value) == 0 && value == expected) {
+            return zclock_usecs() - start;
+        }
+        zclock_sleep(1);
+    }
+
+    return -1;
+}
+
+/// Toggle the probe alert, return its end-to-end latency in usecs. (or -1 on
+/// timeout).
+static int64_t s_probe(mlm_client_t* client, bool& active, int64_t timeout)
+{
+    active = !active;
+
+    zmsg_t* msg = fty_proto_encode_alert(nullptr, uint64_t(zclock_time() / 1000), 3600, "loadgen@probe", PROBE,
+        active ? "ACTIVE" : "RESOLVED", "WARNING", "", nullptr);
+
+    const int64_t start = zclock_usecs();
+    mlm_client_send(client, "alert", &msg);
+
+    return s_waitMetric(PROBE, active ? "1" : "0", start, timeout);
+}
+
+static double s_percentile(const std::vector<int64_t>& sorted, double p)
+{
+    return sorted.empty() ? 0.0 : double(sorted[size_t(p * double(sorted.size() - 1))]) / 1000.0;
+}
+
+int main(int argc, char* argv[])
+{
+    LoadgenOptions options;
+
+    ftylog_setInstance("fty-alert-stats-loadgen", FTY_COMMON_LOGGING_DEFAULT_CFG);
+
+    for (int argn = 1; argn < argc; argn++) {
+        const char* value = argn + 1 < argc ? argv[argn + 1] : nullptr;
+
+        if (streq(argv[argn], "--help") || streq(argv[argn], "-h")) {
+            puts("fty-alert-stats-loadgen [options] ...");
+            puts("  --width N              children per asset of the topology (default 10)");
+            puts("  --depth N              levels below the datacenter (default 4)");
+            puts("  --rate N               alerts/sec. of the first step, doubled at each step (default 1000)");
+            puts("  --max-rate N           alerts/sec. of the last step (default 512000)");
+            puts("  --duration N           seconds per step (default 5)");
+            puts("  --latency-bound N      highest acceptable p99 latency in msec. (default 2000)");
+            puts("  --help / -h            this information");
+            return EXIT_SUCCESS;
+        } else if (value && streq(argv[argn], "--width")) {
+            options.width = std::stoi(value);
+        } else if (value && streq(argv[argn], "--depth")) {
+            options.depth = std::stoi(value);
+        } else if (value && streq(argv[argn], "--rate")) {
+            options.rate = std::stol(value);
+        } else if (value && streq(argv[argn], "--max-rate")) {
+            options.maxRate = std::stol(value);
+        } else if (value && streq(argv[argn], "--duration")) {
+            options.duration = std::stol(value);
+        } else if (value && streq(argv[argn], "--latency-bound")) {
+            options.latencyBound = std::stol(value);
+        } else {
+            log_error("Unknown option or missing value: %s", argv[argn]);
+            return EXIT_FAILURE;
+        }
+        argn++;
+    }
+
+    fty_shm_set_test_dir(".");
+
+    zactor_t* server = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    zstr_sendx(server, "BIND", ENDPOINT, NULL);
+
+    AlertStatsActorParams params;
+    params.endpoint      = ENDPOINT;
+    params.metricTTL     = 720;
+    params.pollerTimeout = 180 * 1000;
+    zactor_t* agent      = zactor_new(fty_alert_stats_server, reinterpret_cast<void*>(&params));
+
+    mlm_client_t* assets = mlm_client_new();
+    mlm_client_connect(assets, ENDPOINT, 1000, "loadgen-assets");
+    mlm_client_set_producer(assets, FTY_PROTO_STREAM_ASSETS);
+    mlm_client_t* probe = mlm_client_new();
+    mlm_client_connect(probe, ENDPOINT, 1000, "loadgen-probe");
+    mlm_client_set_producer(probe, FTY_PROTO_STREAM_ALERTS);
+
+    // Publish the topology, the probe asset last so that its metric tells when the agent caught up
+    std::vector<std::string> leaves;
+    int64_t                  start = zclock_usecs();
+    s_publishTopology(assets, "datacenter-0", "", 0, options, leaves);
+    s_publishAsset(assets, PROBE, "datacenter-0");
+
+    if (s_waitMetric(PROBE, "0", start, 60000) < 0) {
+        log_fatal("Agent did not process the topology in time.");
+        return EXIT_FAILURE;
+    }
+    printf("Topology of %zu leaves (width %d, depth %d) processed in %.1f ms.\n\n", leaves.size(), options.width,
+        options.depth, double(zclock_usecs() - start) / 1000.0);
+
+    printf("%10s %10s %7s %9s %9s %9s %9s %9s  %s\n", "target/s", "sent/s", "probes", "timeouts", "p50 ms", "p99 ms",
+        "max ms", "drain ms", "verdict");
+
+    AlertStorm storm(leaves);
+    bool       probeActive   = false;
+    int64_t    sustainedRate = 0;
+
+    for (int64_t rate = options.rate, step = 0; rate <= options.maxRate; rate *= 2, step++) {
+        std::vector<int64_t> latencies;
+        int                  timeouts = 0;
+
+        storm.start(rate, int(step));
+
+        const int64_t stepStart = zclock_usecs();
+        while (zclock_usecs() - stepStart < options.duration * 1000000) {
+            int64_t latency = s_probe(probe, probeActive, options.duration * 1000);
+            if (latency < 0) {
+                timeouts++;
+            } else {
+                latencies.push_back(latency);
+            }
+            zclock_sleep(100);
+        }
+
+        const int64_t sent     = storm.stop();
+        const int64_t sentRate = sent * 1000000 / (zclock_usecs() - stepStart);
+
+        // Let the agent drain its backlog before the next step
+        const int64_t drain = s_probe(probe, probeActive, 60000);
+
+        std::sort(latencies.begin(), latencies.end());
+        const double p99 = s_percentile(latencies, 0.99);
+
+        const char* verdict = "sustained";
+        if (sentRate < rate * 95 / 100) {
+            verdict = "generator limited";
+        } else if (timeouts || latencies.empty() || p99 > double(options.latencyBound)) {
+            verdict = "falling behind";
+        }
+
+        printf("%10" PRIi64 " %10" PRIi64 " %7zu %9d %9.1f %9.1f %9.1f %9.1f  %s\n", rate, sentRate,
+            latencies.size() + size_t(timeouts), timeouts, s_percentile(latencies, 0.5), p99,
+            s_percentile(latencies, 1.0), drain < 0 ? -1.0 : double(drain) / 1000.0, verdict);
+        fflush(stdout);
+
+        if (!streq(verdict, "sustained")) {
+            break;
+        }
+        sustainedRate = sentRate;
+    }
+
+    printf("\nMaximum sustained rate: %" PRIi64 " alerts/s (p99 latency within %" PRIi64 " ms).\n", sustainedRate,
+        options.latencyBound);
+
+    mlm_client_destroy(&probe);
+    mlm_client_destroy(&assets);
+    zactor_destroy(&agent);
+    zactor_destroy(&server);
+
+    fty_shm_delete_test_dir();
+
+    return EXIT_SUCCESS;
+}
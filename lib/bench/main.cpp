@@ -0,0 +1,45 @@
+/*  ========================================================================
+    Copyright (C) 2020 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+
+
+#define CATCH_CONFIG_RUNNER // Own main(), to add the topology options
+#include "bench.h"
+#include <catch2/catch.hpp>
+
+BenchTopology& benchTopology()
+{
+    static BenchTopology topology;
+    return topology;
+}
+
+int main(int argc, char* argv[])
+{
+    Catch::Session session;
+    BenchTopology& topology = benchTopology();
+
+    using namespace Catch::clara;
+    auto cli = session.cli() |
+               Opt(topology.width, "width")["--width"]("number of children per asset of the synthetic topology") |
+               Opt(topology.depth, "depth")["--depth"]("number of levels below the datacenter");
+    session.cli(cli);
+
+    int r = session.applyCommandLine(argc, argv);
+    if (r != 0) {
+        return r;
+    }
+
+    return session.run();
+}
@@ -0,0 +1,101 @@
+/*  ========================================================================
+    Copyright (C) 2020 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+        MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+
+
+#include "bench.h"
+#include "src/fty_alert_stats_topology.h"
+#include "src/fty_alert_stats_trace.h"
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// Build the synthetic topology, return its leaves.
+std::vector<AssetTopology::Id> buildTopology(AssetTopology& topology, const BenchTopology& shape)
+{
+    std::vector<AssetTopology::Id> level = {topology.intern("datacenter-0")};
+
+    for (int depth = 0; depth < shape.depth; depth++) {
+        std::vector<AssetTopology::Id> children;
+        for (AssetTopology::Id parent : level) {
+            for (int i = 0; i < shape.width; i++) {
+                AssetTopology::Id child = topology.intern(topology.name(parent) + "-" + std::to_string(i));
+                topology.setParent(child, parent);
+                children.push_back(child);
+            }
+        }
+        level.swap(children);
+    }
+
+    return level;
+}
+
+} // namespace
+
+/// Add (or remove) an alert on each leaf and its ancestors, tracing each level
+/// like the incremental recomputation does.
+#define WALK_ALERTS(function, trace)                                                                                   \
+    static void function(AssetTopology& topology, const std::vector<AssetTopology::Id>& leaves, int sign)              \
+    {                                                                                                                  \
+        AlertCounters delta;                                                                                           \
+        delta[AlertCategory::ACTIVE_WARNING] = sign;                                                                   \
+                                                                                                                       \
+        for (AssetTopology::Id leaf : leaves) {                                                                        \
+            trace("alert=%s state=%s severity=%s interesting.", topology.name(leaf).c_str(), "ACTIVE", "WARNING");     \
+                                                                                                                       \
+            for (AssetTopology::Id cur = leaf; cur != AssetTopology::NONE; cur = topology.parent(cur)) {               \
+                AlertCounters& counters = topology.counters(cur);                                                      \
+                trace("asset=%s update count %s + %s.", topology.name(cur).c_str(), counters.str().c_str(),            \
+                    delta.str().c_str());                                                                              \
+                counters += delta;                                                                                     \
+            }                                                                                                          \
+        }                                                                                                              \
+    }
+
+WALK_ALERTS(walkTraced, log_trace)
+WALK_ALERTS(walkLazyTraced, log_trace_lazy_on)
+WALK_ALERTS(walkUntraced, log_trace_lazy_off)
+
+TEST_CASE("hot path trace logging")
+{
+    AssetTopology                  topology;
+    std::vector<AssetTopology::Id> leaves = buildTopology(topology, benchTopology());
+
+    // The cost that matters is the one with trace logging disabled, as in production
+    ftylog_getInstance()->setLogLevelInfo();
+    REQUIRE(!ftylog_getInstance()->isLogTrace());
+
+    int sign = 1;
+
+    BENCHMARK("alert walks, log_trace")
+    {
+        walkTraced(topology, leaves, sign = -sign);
+        return topology.counters(0)[AlertCategory::ACTIVE_WARNING];
+    };
+
+    BENCHMARK("alert walks, log_trace_lazy")
+    {
+        walkLazyTraced(topology, leaves, sign = -sign);
+        return topology.counters(0)[AlertCategory::ACTIVE_WARNING];
+    };
+
+    BENCHMARK("alert walks, log_trace_lazy compiled out")
+    {
+        walkUntraced(topology, leaves, sign = -sign);
+        return topology.counters(0)[AlertCategory::ACTIVE_WARNING];
+    };
+}
@@ -20,298 +20,716 @@
 */
 
 #include "fty_alert_stats_actor.h"
+#include "fty_alert_stats_trace.h"
+#include <algorithm>
+#include <cinttypes>
 #include <fty_log.h>
-#include <fty_shm.h>
 #include <stdexcept>
 
-AlertStatsActor::AlertStatsActor(zsock_t* pipe, const char* endpoint, int64_t pollerTimeout, int64_t metricTTL)
-    : MlmAgent(pipe, endpoint, "fty-alert-stats", int(pollerTimeout))
-    , m_alertCounts()
+/// Take over the frames of a message owned by someone else, without copying
+/// them. The original message is left empty.
+static zmsg_t* s_takeFrames(zmsg_t* message)
+{
+    zmsg_t*   taken = zmsg_new();
+    zframe_t* frame;
+
+    while ((frame = zmsg_pop(message))) {
+        zmsg_append(taken, &frame);
+    }
+
+    return taken;
+}
+
+/// Category an alert is tallied in, by state and severity (NO_CATEGORY if none).
+static constexpr AlertCategory NO_CATEGORY = AlertCategory::COUNT;
+
+static constexpr AlertCategory s_categories[size_t(FtyAlertState::COUNT)][size_t(FtyAlertSeverity::COUNT)] = {
+    // UNKNOWN, CRITICAL, WARNING, INFO
+    {NO_CATEGORY, NO_CATEGORY, NO_CATEGORY, NO_CATEGORY}, // UNKNOWN
+    {NO_CATEGORY, AlertCategory::ACTIVE_CRITICAL, AlertCategory::ACTIVE_WARNING, AlertCategory::ACTIVE_INFO},
+    {NO_CATEGORY, AlertCategory::ACKNOWLEDGED_CRITICAL, AlertCategory::ACKNOWLEDGED_WARNING,
+        AlertCategory::ACKNOWLEDGED_INFO},
+    {NO_CATEGORY, NO_CATEGORY, NO_CATEGORY, NO_CATEGORY}, // RESOLVED
+};
+
+static AlertCategory s_category(const FtyAlertRecord& alert)
+{
+    return s_categories[size_t(alert.state)][size_t(alert.severity)];
+}
+
+/// Add (or, with a negative sign, remove) the contribution of an alert to a tally.
+static void s_tally(AlertCounters& counters, const FtyAlertRecord& alert, int sign)
+{
+    const AlertCategory category = s_category(alert);
+
+    if (category != NO_CATEGORY) {
+        counters[category] += sign;
+    }
+}
+
+AlertStatsActor::AlertStatsActor(zsock_t* pipe, const AlertStatsActorParams& params)
+    : MlmAgent(pipe, params.endpoint.c_str(), "fty-alert-stats", int(params.pollerTimeout))
+    , m_topology()
+    , m_retiredAssets()
+    , m_dirtyAssets()
+    , m_dirtySince(0)
+    , m_refreshSchedule()
     , m_assetQueries()
+    , m_assetQuerySendTimes()
     , m_outstandingAssetQueries()
+    , m_assetQueryWindow(std::min(ASSET_QUERY_INITIAL_WINDOW, int(params.assetQueryWindow)))
+    , m_assetQueryBackoff(0)
     , m_readyAssets(true)
     , m_readyAlerts(true)
     , m_lastResync(0)
-    , m_metricTTL(metricTTL)
-    , m_pollerTimeout(pollerTimeout)
+    , m_resyncStart(0)
+    , m_counters()
+    , m_lastHealth(zclock_mono())
+    , m_lastHealthMessages(0)
+    , m_nextHealth(m_lastHealth + params.pollerTimeout)
+    , m_publishLagMax(0)
+    , m_queueLagMax(0)
+    , m_decodedReceived(0)
+    , m_lastResyncDuration(-1)
+    , m_lastResyncDone(0)
+    , m_metrics(params.metrics.empty() ? defaultAlertMetrics() : params.metrics)
+    , m_publishedCategories(0)
+    , m_classifier(params.publishPrefixes, params.publishTypes)
+    , m_metricTTL(params.metricTTL)
+    , m_pollerTimeout(params.pollerTimeout)
+    , m_publishLatency(params.publishLatency)
+    , m_streamBatch(std::max(int64_t(1), params.streamBatch))
+    , m_streamBatchBudget(params.streamBatchBudget)
+    , m_assetQueryBatch(std::max(int64_t(1), params.assetQueryBatch))
+    , m_assetQueryWindowMax(std::max(1, int(params.assetQueryWindow)))
+    , m_decodeCounters()
+    , m_decoder(nullptr)
+    , m_writer()
 {
-    if (mlm_client_set_consumer(client(), FTY_PROTO_STREAM_ASSETS, ".*") == -1) {
-        log_error("mlm_client_set_consumer(stream = '%s', pattern = '%s') failed.", FTY_PROTO_STREAM_ASSETS, ".*");
-        throw std::runtime_error("Can't set client consumer");
-    }
-
-    if (mlm_client_set_consumer(client(), FTY_PROTO_STREAM_ALERTS, ".*") == -1) {
-        log_error("mlm_client_set_consumer(stream = '%s', pattern = '%s') failed.", FTY_PROTO_STREAM_ALERTS, ".*");
-        throw std::runtime_error("Can't set client consumer");
+    for (const AlertMetric& metric : m_metrics) {
+        m_publishedCategories |= metric.categories;
     }
 
     if (mlm_client_set_producer(client(), FTY_PROTO_STREAM_METRICS) == -1) {
         log_error("mlm_client_set_producer(stream = '%s') failed.", FTY_PROTO_STREAM_METRICS);
         throw std::runtime_error("Can't set client producer");
     }
+
+    // The streams are consumed by the decode stage, through a client of its own
+    mlm_client_t* streamClient = mlm_client_new();
+
+    if (mlm_client_connect(streamClient, params.endpoint.c_str(), 1000, STREAM_CLIENT_ADDRESS) == -1) {
+        log_error("mlm_client_connect(endpoint = '%s', address = '%s') failed.", params.endpoint.c_str(),
+            STREAM_CLIENT_ADDRESS);
+        mlm_client_destroy(&streamClient);
+        throw std::runtime_error("Can't connect stream client");
+    }
+
+    for (const char* stream : {FTY_PROTO_STREAM_ASSETS, FTY_PROTO_STREAM_ALERTS}) {
+        if (mlm_client_set_consumer(streamClient, stream, ".*") == -1) {
+            log_error("mlm_client_set_consumer(stream = '%s', pattern = '%s') failed.", stream, ".*");
+            mlm_client_destroy(&streamClient);
+            throw std::runtime_error("Can't set client consumer");
+        }
+    }
+
+    DecodeStageArgs decoderArgs = {streamClient, &m_decodeCounters};
+    m_decoder                   = zactor_new(fty_alert_stats_decoder, &decoderArgs);
+
+    if (!m_decoder) {
+        log_error("zactor_new(fty_alert_stats_decoder) failed.");
+        mlm_client_destroy(&streamClient);
+        throw std::runtime_error("Can't start decode stage");
+    }
+}
+
+AlertStatsActor::~AlertStatsActor()
+{
+    /**
+     * Stop the decode stage, disposing of the objects it handed over that we
+     * haven't received yet. A message without object means the stage is gone
+     * already.
+     */
+    zsock_t* decoded = zactor_sock(m_decoder);
+    zstr_send(m_decoder, "STOP");
+
+    while (true) {
+        char*    command   = nullptr;
+        void*    object    = nullptr;
+        uint64_t timestamp = 0;
+
+        if (zsock_recv(decoded, "sp8", &command, &object, &timestamp) == -1) {
+            break;
+        }
+
+        const bool stopped = streq(command, "STOPPED") || object == nullptr;
+        zstr_free(&command);
+        if (stopped) {
+            break;
+        }
+
+        fty_proto_t* proto = reinterpret_cast<fty_proto_t*>(object);
+        fty_proto_destroy(&proto);
+    }
+
+    zactor_destroy(&m_decoder);
 }
 
-bool AlertStatsActor::callbackAssetPre(fty_proto_t* asset)
+void AlertStatsActor::run()
 {
-    const char* name      = fty_proto_name(asset);
-    const char* operation = fty_proto_operation(asset);
+    /**
+     * Same loop as mlm::MlmAgent::mainloop(), with the decode stage in place of
+     * the streams of the agent client.
+     */
+    zsock_t*   decoded = zactor_sock(m_decoder);
+    zpoller_t* poller  = zpoller_new(pipe(), mlm_client_msgpipe(client()), decoded, nullptr);
 
+    zsock_signal(pipe(), 0);
+
+    bool keepGoing = true;
+    while (keepGoing) {
+        void* which = zpoller_wait(poller, int(m_pollerTimeout));
+
+        if (which == nullptr) {
+            if (zpoller_terminated(poller)) {
+                break;
+            }
+            keepGoing = tick();
+        } else if (which == pipe()) {
+            zmsg_t* message = zmsg_recv(pipe());
+            if (!message) {
+                break;
+            }
+            keepGoing = handlePipe(message);
+            zmsg_destroy(&message);
+        } else if (which == decoded) {
+            keepGoing = handleDecoded();
+        } else {
+            zmsg_t* message = mlm_client_recv(client());
+            if (!message) {
+                break;
+            }
+            if (streq(mlm_client_command(client()), "MAILBOX DELIVER")) {
+                keepGoing = handleMailbox(message);
+            }
+            zmsg_destroy(&message);
+        }
+    }
+
+    zpoller_destroy(&poller);
+}
+
+bool AlertStatsActor::callbackAssetPre(const std::string& name, const char* operation, const FtyAssetRecord& asset)
+{
     // Filter things we are interested in
     if (streq(operation, FTY_PROTO_ASSET_OP_INVENTORY)) {
         return false;
     } else if (streq(operation, FTY_PROTO_ASSET_OP_UPDATE)) {
-        if (m_assets.count(name)) {
-            fty_proto_t* oldAsset = m_assets[name].get();
-
-            // We only care about topology, ignore update if the asset has not been reparented
-            const char* parent = fty_proto_aux_string(asset, FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "_no_parent_for_asset");
-            const char* oldParent =
-                fty_proto_aux_string(oldAsset, FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "_no_parent_for_asset");
+        auto it = m_assets.find(name);
 
-            if (streq(oldParent, parent)) {
-                return false;
-            }
+        // We only care about topology, ignore update if the asset has not been reparented
+        if (it != m_assets.end() && it->second.parent == asset.parent && it->second.ancestors == asset.ancestors &&
+            it->second.type == asset.type && it->second.subtype == asset.subtype) {
+            return false;
         }
     }
 
     return true;
 }
 
-void AlertStatsActor::callbackAssetPost(fty_proto_t* asset)
+void AlertStatsActor::callbackAssetPost(const std::string& name, const char* operation, const FtyAssetRecord& asset)
 {
     /**
      * An asset has been modified, trigger recompute.
      */
-    const char* name      = fty_proto_name(asset);
-    const char* operation = fty_proto_operation(asset);
-
-    if (streq(operation, FTY_PROTO_ASSET_OP_CREATE)) {
-        m_alertCounts[name] = AlertCount();
-        bool mustRecurse    = false;
-
-        // Just update alerts attached to the asset.
-        for (FtyProtoCollection::value_type& i : m_alerts) {
-            if (streq(fty_proto_name(i.second.get()), name)) {
-                recomputeAlert(i.second.get(), nullptr);
-                mustRecurse = true;
-            }
-        }
+    const bool gone = streq(operation, FTY_PROTO_ASSET_OP_DELETE) || streq(operation, FTY_PROTO_ASSET_OP_RETIRE);
+    if (gone) {
+        m_retiredAssets.insert(name);
+    } else {
+        m_retiredAssets.erase(name);
+    }
+
+    AssetTopology::Id id = internAsset(name);
 
-        sendMetric(*(m_alertCounts.find(name)), mustRecurse);
+    if (gone) {
+        /**
+         * The asset is gone, so its subtree no longer contributes to its former
+         * ancestors. The tally of the asset itself is kept, as alerts (or
+         * children) may still reference it, but its metrics are no longer
+         * published nor refreshed, so they expire. Children or paths still
+         * naming it don't bring it back until it is recreated.
+         */
+        const Ancestors prevAncestors = ancestorsOf(id);
+        m_topology.setParent(id, AssetTopology::NONE);
+        moveSubtree(id, prevAncestors, {});
+
+        AlertPublication& publication = m_topology.publication(id);
+        publication.publishable       = false;
+        publication.published         = false;
+        publication.dirty             = false;
     } else {
         /**
-         * Since the topology itself of the assets has been altered when we get
-         * here, we trigger a complete recompute of the alert tallies and
-         * republication of the associated metrics. We could do a better job at
-         * tracking what happened, but unless there's a huge datacenter that is
-         * being thoroughly scrambled around at the speed of sound we shouldn't
-         * cause a meltdown.
+         * The asset has been created or reparented. Its tally already accounts
+         * for everything below it, including the alerts raised on it and the
+         * children attached to it before it was known, so we only need to move
+         * it from the old ancestor chain to the new one.
          */
-        recomputeAlerts();
+        linkAncestors(asset);
+
+        AssetTopology::Id parentId = parentOf(asset);
+        if (closesLoop(id, parentId)) {
+            parentId = AssetTopology::NONE;
+        }
+
+        const Ancestors prevAncestors = ancestorsOf(id);
+        m_topology.setParent(id, parentId);
+        moveSubtree(id, prevAncestors, ancestorsOf(id));
+
+        // Its record tells whether it is publishable, and a new one may never have had its metrics published
+        m_topology.publication(id).publishable = m_classifier.classify(name, asset.type, asset.subtype);
+        markDirty(id, false);
     }
 }
 
-bool AlertStatsActor::callbackAlertPre(fty_proto_t* alert)
+bool AlertStatsActor::callbackAlertPre(const std::string& rule, const FtyAlertRecord& alert)
 {
     // Do inline update
-    const char* rule = fty_proto_rule(alert);
+    const FtyAlertRecord* prevAlert = nullptr;
 
-    fty_proto_t* prevAlert = nullptr;
-    if (m_alerts.count(rule)) {
-        prevAlert = m_alerts[rule].get();
+    auto it = m_alerts.find(rule);
+    if (it != m_alerts.end()) {
+        prevAlert = &it->second;
     }
 
-    if (recomputeAlert(alert, prevAlert)) {
-        auto it = m_alertCounts.find(fty_proto_name(alert));
-        if (it != m_alertCounts.end()) {
-            sendMetric(*it);
+    if (recomputeAlert(rule, alert, prevAlert)) {
+        AssetTopology::Id id = m_topology.find(alert.name);
+        if (id != AssetTopology::NONE) {
+            markDirty(id);
         }
     }
 
     return true;
 }
 
-void AlertStatsActor::recomputeAlerts()
+void AlertStatsActor::recomputeAlerts(bool republish)
 {
-    if (isReady()) {
-        // Don't spam if we're not sending stats
-        log_debug("Recomputing all statistics...");
+    const int64_t start = zclock_usecs();
+    log_debug("Recomputing all statistics...");
+
+    // Rebuild topology and recompute/resend/refresh metrics with our current data
+    AssetTopology previous;
+    std::swap(previous, m_topology);
+    m_dirtyAssets.clear();
+    m_refreshSchedule = RefreshSchedule();
+
+    for (const FtyAssetCollection::value_type& i : m_assets) {
+        AssetTopology::Id id       = internAsset(i.first);
+        AssetTopology::Id parentId = parentOf(i.second);
+        if (!closesLoop(id, parentId)) {
+            m_topology.setParent(id, parentId);
+        }
+        m_topology.publication(id).publishable = m_classifier.classify(i.first, i.second.type, i.second.subtype);
     }
 
-    // Recompute and resend/refresh metrics with our current data
-    m_alertCounts.clear();
-
-    for (FtyProtoCollection::value_type& i : m_assets) {
-        m_alertCounts.emplace(i.first, AlertCount());
+    /**
+     * Containers we have no record of are attached according to the paths
+     * carried by their descendants. Records are replayed in the order they
+     * were received, so that the latest path wins like it does incrementally.
+     */
+    std::vector<const FtyAssetRecord*> records;
+    records.reserve(m_assets.size());
+    for (const FtyAssetCollection::value_type& i : m_assets) {
+        records.push_back(&i.second);
     }
-    for (FtyProtoCollection::value_type& i : m_alerts) {
-        recomputeAlert(i.second.get(), nullptr);
+    std::sort(records.begin(), records.end(),
+        [](const FtyAssetRecord* a, const FtyAssetRecord* b) { return a->sequence < b->sequence; });
+    for (const FtyAssetRecord* asset : records) {
+        linkAncestors(*asset, false);
     }
-    if (isReady()) {
-        log_debug("Finished recomputing statistics, publishing all metrics...");
-    }
-    for (auto& i : m_alertCounts) {
-        sendMetric(i, false);
+
+    // Tally the alerts of each asset, then aggregate them bottom-up in one pass
+    for (const FtyAlertCollection::value_type& i : m_alerts) {
+        s_tally(m_topology.counters(m_topology.intern(i.second.name)), i.second, 1);
     }
+    m_topology.aggregate();
+
+    log_debug("Finished recomputing statistics, publishing all metrics...");
+    for (AssetTopology::Id id = 0; id < m_topology.size(); id++) {
+        // Carry over what we know was already published, so unchanged metrics aren't rewritten
+        AssetTopology::Id prevId = previous.find(m_topology.name(id));
+        if (prevId != AssetTopology::NONE) {
+            const AlertPublication& prevPublication = previous.publication(prevId);
+            AlertPublication&       publication     = m_topology.publication(id);
+
+            publication.lastSent  = prevPublication.lastSent;
+            publication.sent      = prevPublication.sent;
+            publication.published = prevPublication.published;
+        }
 
-    if (isReady()) {
-        log_info("All metrics published.");
+        sendMetric(id, republish);
     }
+
+    m_counters.recomputeDuration.record(zclock_usecs() - start);
+    log_info("All metrics published.");
 }
 
-bool AlertStatsActor::recomputeAlert(fty_proto_t* alert, fty_proto_t* prevAlert)
+bool AlertStatsActor::recomputeAlert(
+    const std::string& rule, const FtyAlertRecord& alert, const FtyAlertRecord* prevAlert)
 {
-    bool        r = false;
-    AlertCount  delta;
-    const char* state        = fty_proto_state(alert);
-    const char* severity     = fty_proto_severity(alert);
-    const char* prevSeverity = nullptr;
-    const char* prevState    = nullptr;
+    // The alert moves its contribution from one category of the tally to another (if any)
+    const AlertCategory category     = s_category(alert);
+    const AlertCategory prevCategory = prevAlert ? s_category(*prevAlert) : NO_CATEGORY;
 
+    AlertCounters delta;
+    s_tally(delta, alert, 1);
     if (prevAlert) {
-        prevSeverity = fty_proto_severity(prevAlert);
-        prevState    = fty_proto_state(prevAlert);
+        s_tally(delta, *prevAlert, -1);
     }
 
-    // Filter state transitions we're interested in
+    // Every category is tallied, but only those of published metrics are worth publishing
+    const bool  r            = !delta.equal(AlertCounters(), m_publishedCategories);
+    const char* state        = alertStateName(alert.state);
+    const char* severity     = alertSeverityName(alert.severity);
+    const char* prevState    = prevAlert ? alertStateName(prevAlert->state) : nullptr;
+    const char* prevSeverity = prevAlert ? alertSeverityName(prevAlert->severity) : nullptr;
+
+    if (!delta.empty()) {
+        log_trace_lazy("alert=%s state=%s severity=%s prev_state=%s prev_severity=%s interesting.", rule.c_str(), state,
+            severity, prevState ? prevState : "(null)", prevSeverity ? prevSeverity : "(null)");
+
+        // Update alert count of asset and all parents (an alert alone doesn't make its asset publishable)
+        AssetTopology::Id curAsset = m_topology.intern(alert.name);
+
+        // Only the counters of these (at most two) categories change, rather than adding the whole delta
+        while (curAsset != AssetTopology::NONE) {
+            AlertCounters& counters = m_topology.counters(curAsset);
 
-    // New alert with ACTIVE state
-    if ((!prevAlert && streq(state, "ACTIVE")) ||
-        (prevAlert && !streq(prevState, "ACTIVE") && streq(state, "ACTIVE"))) {
-        r = true;
+            log_trace_lazy("asset=%s update count %s + %s.", m_topology.name(curAsset).c_str(),
+                counters.str().c_str(), delta.str().c_str());
 
-        if (streq(severity, "CRITICAL")) {
-            delta.critical = 1;
-        } else if (streq(severity, "WARNING")) {
-            delta.warning = 1;
+            if (category != NO_CATEGORY) {
+                counters[category]++;
+            }
+            if (prevCategory != NO_CATEGORY) {
+                counters[prevCategory]--;
+            }
+            curAsset = m_topology.parent(curAsset);
         }
+    } else {
+        log_trace_lazy("alert=%s state=%s severity=%s prev_state=%s prev_severity=%s not interesting.", rule.c_str(),
+            state, severity, prevState ? prevState : "(null)", prevSeverity ? prevSeverity : "(null)");
     }
-    // Known ACTIVE alert switching away from ACTIVE state
-    else if (prevAlert && streq(prevState, "ACTIVE") && !streq(state, "ACTIVE")) {
-        r = true;
 
-        if (streq(prevSeverity, "CRITICAL")) {
-            delta.critical = -1;
-        } else if (streq(prevSeverity, "WARNING")) {
-            delta.warning = -1;
-        }
+    return r;
+}
+
+AssetTopology::Id AlertStatsActor::internAsset(const std::string& name)
+{
+    AssetTopology::Id id          = m_topology.intern(name);
+    AlertPublication& publication = m_topology.publication(id);
+
+    // Containers we have no record of are classified by name, until we get their record (if ever)
+    if (!publication.publishable && isImplied(name)) {
+        publication.publishable = m_classifier.classify(name);
     }
-    // Known ACTIVE alert changing severity
-    else if (prevAlert && streq(state, "ACTIVE") && streq(prevState, "ACTIVE") && !streq(severity, prevSeverity)) {
-        r = true;
 
-        if (streq(prevSeverity, "CRITICAL")) {
-            delta.critical = -1;
-        } else if (streq(prevSeverity, "WARNING")) {
-            delta.warning = -1;
+    return id;
+}
+
+bool AlertStatsActor::isImplied(const std::string& name) const
+{
+    return m_assets.find(name) == m_assets.end() && m_retiredAssets.find(name) == m_retiredAssets.end();
+}
+
+AssetTopology::Id AlertStatsActor::parentOf(const FtyAssetRecord& asset)
+{
+    return asset.parent.empty() ? AssetTopology::NONE : internAsset(asset.parent);
+}
+
+void AlertStatsActor::linkAncestors(const FtyAssetRecord& asset, bool moveTallies)
+{
+    /**
+     * Assets carry their whole path up to the top-level asset. Containers we
+     * have no record of (yet) are attached according to it, so that alerts
+     * below them reach all of their ancestors whatever the order in which
+     * assets are received. Known containers are only ever attached according
+     * to their own record, and deleted or retired ones not at all, as paths
+     * still naming them are stale.
+     *
+     * The path is walked from the top down, so that each container is
+     * attached to a complete chain. A container named by several paths ends
+     * up where the latest one puts it.
+     *
+     * Tallies are moved along, unless they are about to be recomputed.
+     */
+    for (size_t level = asset.ancestors.size(); level-- > 0;) {
+        const std::string& child = level == 0 ? asset.parent : asset.ancestors[level - 1];
+
+        if (!isImplied(child) || m_retiredAssets.find(asset.ancestors[level]) != m_retiredAssets.end()) {
+            continue;
         }
 
-        if (streq(severity, "CRITICAL")) {
-            delta.critical += 1;
-        } else if (streq(severity, "WARNING")) {
-            delta.warning += 1;
+        AssetTopology::Id childId  = internAsset(child);
+        AssetTopology::Id parentId = internAsset(asset.ancestors[level]);
+        if (m_topology.parent(childId) == parentId) {
+            continue;
         }
-    }
 
-    if (r) {
-        if (delta.warning == 0 && delta.critical == 0) {
-            log_error("Interesting alert but computed null delta!");
+        // Don't let a stale path close a loop
+        if (closesLoop(childId, parentId)) {
+            continue;
         }
 
-        // Update alert count of asset and all parents
-        const char* curAsset = fty_proto_name(alert);
+        log_debug("Attaching unknown asset %s to %s.", child.c_str(), asset.ancestors[level].c_str());
+        if (moveTallies) {
+            const Ancestors prevAncestors = ancestorsOf(childId);
+            m_topology.setParent(childId, parentId);
+            moveSubtree(childId, prevAncestors, ancestorsOf(childId));
+        } else {
+            m_topology.setParent(childId, parentId);
+        }
+    }
+}
 
-        log_trace("alert=%s state=%s severity=%s prev_state=%s prev_severity=%s interesting.", fty_proto_rule(alert),
-            state, severity, prevState ? prevState : "(null)", prevSeverity ? prevSeverity : "(null)");
+bool AlertStatsActor::closesLoop(AssetTopology::Id id, AssetTopology::Id parentId) const
+{
+    if (parentId == AssetTopology::NONE) {
+        return false;
+    }
 
-        while (curAsset) {
-            log_trace("asset=%s update count (W %d; C %d) + (W %d; C %d) = (W %d; C %d).", curAsset,
-                m_alertCounts[curAsset].warning, m_alertCounts[curAsset].critical, delta.warning, delta.critical,
-                m_alertCounts[curAsset].warning + delta.warning, m_alertCounts[curAsset].critical + delta.critical);
+    const Ancestors ancestors = ancestorsOf(parentId);
+    if (parentId == id || std::find(ancestors.begin(), ancestors.end(), id) != ancestors.end()) {
+        log_warning("Ignoring parent %s of %s, it would create a loop.", m_topology.name(parentId).c_str(),
+            m_topology.name(id).c_str());
+        return true;
+    }
 
-            m_alertCounts[curAsset] += delta;
-            auto it  = m_assets.find(curAsset);
-            curAsset = nullptr;
+    return false;
+}
 
-            if (it != m_assets.end()) {
-                curAsset = fty_proto_aux_string(it->second.get(), FTY_PROTO_ASSET_AUX_PARENT_NAME_1, nullptr);
-            }
+AlertStatsActor::Ancestors AlertStatsActor::ancestorsOf(AssetTopology::Id id) const
+{
+    Ancestors ancestors;
+
+    // Walk up the topology, bailing out if we loop back onto the starting asset
+    AssetTopology::Id cur = m_topology.parent(id);
+    while (cur != AssetTopology::NONE && cur != id) {
+        ancestors.push_back(cur);
+        cur = m_topology.parent(cur);
+    }
+
+    return ancestors;
+}
+
+void AlertStatsActor::moveSubtree(AssetTopology::Id id, const Ancestors& prevAncestors, const Ancestors& newAncestors)
+{
+    /**
+     * Move the tally of the subtree rooted at the asset from its previous
+     * ancestor chain to the new one. Common ancestors see no net change, so
+     * only the ancestors that are exclusive to either chain are updated and
+     * republished.
+     */
+    const AlertCounters subtree = m_topology.counters(id);
+
+    Ancestors changed;
+    for (AssetTopology::Id ancestor : prevAncestors) {
+        if (std::find(newAncestors.begin(), newAncestors.end(), ancestor) == newAncestors.end()) {
+            m_topology.counters(ancestor) -= subtree;
+            changed.push_back(ancestor);
+        }
+    }
+    for (AssetTopology::Id ancestor : newAncestors) {
+        if (std::find(prevAncestors.begin(), prevAncestors.end(), ancestor) == prevAncestors.end()) {
+            m_topology.counters(ancestor) += subtree;
+            changed.push_back(ancestor);
         }
-    } else {
-        log_trace("alert=%s state=%s severity=%s prev_state=%s prev_severity=%s not interesting.",
-            fty_proto_rule(alert), state, severity, prevState ? prevState : "(null)",
-            prevSeverity ? prevSeverity : "(null)");
     }
 
-    return r;
+    log_debug("asset=%s moved subtree %s, %zu ancestors updated.", m_topology.name(id).c_str(),
+        subtree.str().c_str(), changed.size());
+
+    for (AssetTopology::Id ancestor : changed) {
+        markDirty(ancestor, false);
+    }
 }
 
-void AlertStatsActor::sendMetric(AlertCounts::value_type& metric, bool recursive)
+void AlertStatsActor::markDirty(AssetTopology::Id id, bool recursive)
 {
-    if (!isReady()) {
-        /**
-         * Resynchronizing with the rest of the world. Inhibit sending metrics
-         * until we are ready.
-         */
+    if (m_dirtyAssets.empty()) {
+        m_dirtySince = zclock_mono();
+    }
+
+    while (id != AssetTopology::NONE) {
+        AlertPublication& publication = m_topology.publication(id);
+
+        if (!publication.dirty) {
+            publication.dirty = true;
+            m_dirtyAssets.push_back(id);
+        }
+
+        id = recursive ? m_topology.parent(id) : AssetTopology::NONE;
+    }
+}
+
+void AlertStatsActor::flushMetrics(bool force)
+{
+    if (m_dirtyAssets.empty()) {
         return;
     }
 
-    // Inhibit metrics for simple devices or fty-outage malfunctions
-    const auto& assetId = metric.first;
+    /**
+     * Hold back publication while more messages are already waiting for us, as
+     * they are likely to touch the same assets again. The latency bound
+     * guarantees metrics still get out during a sustained burst.
+     */
+    const bool pending = (zsock_events(zactor_sock(m_decoder)) & ZMQ_POLLIN) ||
+                         (zsock_events(mlm_client_msgpipe(client())) & ZMQ_POLLIN);
 
-    if (assetId.find("datacenter-") == 0 || assetId.find("room-") == 0 || assetId.find("row-") == 0 ||
-        assetId.find("rack-") == 0) {
-        metric.second.lastSent = zclock_time() / 1000;
+    if (!force && pending && (zclock_mono() < m_dirtySince + m_publishLatency)) {
+        return;
+    }
 
-        fty::shm::write_metric(assetId, WARNING_METRIC, std::to_string(metric.second.warning), "", int(m_metricTTL));
+    log_trace_lazy("Publishing metrics of %zu dirty assets.", m_dirtyAssets.size());
+    m_publishLagMax = std::max(m_publishLagMax, zclock_mono() - m_dirtySince);
 
-        fty::shm::write_metric(assetId, CRITICAL_METRIC, std::to_string(metric.second.critical), "", int(m_metricTTL));
-    } else {
-        metric.second.lastSent = INT64_MAX / 2;
+    for (AssetTopology::Id id : m_dirtyAssets) {
+        m_topology.publication(id).dirty = false;
+        sendMetric(id);
     }
+    m_dirtyAssets.clear();
+}
 
-    if (recursive) {
-        // Recursively send metric of parent
-        auto it = m_assets.find(metric.first);
+void AlertStatsActor::sendMetric(AssetTopology::Id id, bool force)
+{
+    // Inhibit metrics for simple devices or fty-outage malfunctions
+    const std::string&   assetId     = m_topology.name(id);
+    const AlertCounters& counters    = m_topology.counters(id);
+    AlertPublication&    publication = m_topology.publication(id);
 
-        if (it != m_assets.end()) {
-            const char* parent = fty_proto_aux_string(it->second.get(), FTY_PROTO_ASSET_AUX_PARENT_NAME_1, nullptr);
+    if (publication.publishable) {
+        int64_t curClock = zclock_time() / 1000;
 
-            if (parent) {
-                auto itParent = m_alertCounts.find(parent);
+        // Nothing to write if shm already holds these values and they don't need a refresh yet
+        if (force || publication.changed(counters, m_publishedCategories) ||
+            (publication.lastSent + m_metricTTL / 2) <= curClock) {
+            publication.lastSent  = curClock;
+            publication.sent      = counters;
+            publication.published = true;
 
-                if (itParent != m_alertCounts.end()) {
-                    sendMetric(*itParent, true);
-                }
+            const int ttl = int(m_metricTTL);
+
+            for (const AlertMetric& metric : m_metrics) {
+                m_writer.write(assetId, metric.name, std::to_string(counters.sum(metric.categories)), "", ttl);
             }
         }
+
+        // Publishable assets get (exactly) one entry in the refresh schedule
+        if (!publication.scheduled) {
+            publication.scheduled = true;
+            m_refreshSchedule.emplace(publication.lastSent + m_metricTTL / 2, id);
+        }
     }
 }
 
 void AlertStatsActor::drainOutstandingAssetQueries()
 {
-    const int MAX_OUTSTANDING_QUERIES = 32;
-
-    while ((m_outstandingAssetQueries < MAX_OUTSTANDING_QUERIES) && !m_assetQueries.empty()) {
-        log_debug("Query details of asset %s...", m_assetQueries.back().c_str());
+    /**
+     * Each query asks for the details of up to m_assetQueryBatch assets. When
+     * batching, asset-agent replies with one fty_proto_t submessage per asset.
+     */
+    const bool batch = m_assetQueryBatch > 1;
 
+    while ((m_outstandingAssetQueries < m_assetQueryWindow) && !m_assetQueries.empty()) {
         zmsg_t* queryMsg = zmsg_new();
         zmsg_addstr(queryMsg, "GET");
-        zmsg_addstr(queryMsg, "_ASSET_DETAIL_RESULT");
-        zmsg_addstr(queryMsg, m_assetQueries.back().c_str());
-        m_assetQueries.pop_back();
+        zmsg_addstr(queryMsg, batch ? ASSET_DETAIL_BATCH_RESULT : ASSET_DETAIL_RESULT);
+
+        std::vector<std::string> names;
+        while (!m_assetQueries.empty() && int64_t(names.size()) < m_assetQueryBatch) {
+            log_debug("Query details of asset %s...", m_assetQueries.back().c_str());
+
+            zmsg_addstr(queryMsg, m_assetQueries.back().c_str());
+            names.push_back(std::move(m_assetQueries.back()));
+            m_assetQueries.pop_back();
+        }
 
         if (mlm_client_sendto(client(), "asset-agent", "ASSET_DETAIL", nullptr, 5000, &queryMsg) == 0) {
             m_outstandingAssetQueries++;
+            m_assetQuerySendTimes.push_back(zclock_mono());
+        } else {
+            // Back off and retry later
+            log_warning("Couldn't query details of %zu assets, will retry.", names.size());
+            m_assetQueries.insert(m_assetQueries.end(), names.rbegin(), names.rend());
+            m_assetQueryWindow = std::max(1, m_assetQueryWindow / 2);
+            break;
         }
     }
 }
 
+void AlertStatsActor::completeAssetQuery()
+{
+    if (m_outstandingAssetQueries > 0) {
+        --m_outstandingAssetQueries;
+    }
+
+    if (!m_assetQuerySendTimes.empty()) {
+        /**
+         * Adapt the number of queries in flight: grow it while asset-agent
+         * answers promptly, halve it (at most once per round trip) as soon as
+         * replies start lagging behind.
+         */
+        int64_t now     = zclock_mono();
+        int64_t latency = now - m_assetQuerySendTimes.front();
+        m_assetQuerySendTimes.pop_front();
+
+        if (latency > ASSET_QUERY_LATENCY_TARGET) {
+            if (now - m_assetQueryBackoff > latency) {
+                m_assetQueryWindow  = std::max(1, m_assetQueryWindow / 2);
+                m_assetQueryBackoff = now;
+                log_debug("Asset queries lagging (%" PRIi64 " ms), window shrunk to %d.", latency, m_assetQueryWindow);
+            }
+        } else if (m_assetQueryWindow < m_assetQueryWindowMax) {
+            m_assetQueryWindow++;
+        }
+    }
+
+    drainOutstandingAssetQueries();
+
+    if (m_outstandingAssetQueries == 0 && m_assetQueries.empty() && !m_readyAssets) {
+        log_info("Finished resync of all assets.");
+        m_readyAssets = true;
+
+        if (m_resyncStart) {
+            m_counters.resyncAssetsDuration.record(zclock_usecs() - m_resyncStart);
+        }
+    }
+}
+
+void AlertStatsActor::injectAsset(zmsg_t** assetMsg)
+{
+    fty_proto_t* assetProto = fty_proto_decode(assetMsg);
+
+    if (assetProto) {
+        log_debug("Injecting asset '%s'.", fty_proto_name(assetProto));
+        m_counters.resyncAssets++;
+
+        // Bulk load while resynchronizing, statistics are computed once when done
+        if (m_readyAssets) {
+            processAsset(assetProto);
+        } else {
+            loadAsset(assetProto);
+        }
+    } else {
+        log_error("Couldn't decode asset fty_proto_t message.");
+        m_counters.decodeFailures++;
+    }
+}
+
 void AlertStatsActor::startResynchronization()
 {
     /**
-     * Stop sending metrics, resync all our data, recompute statistics and
-     * resume sending metrics.
+     * Resync all our data in the background, then swap it in and publish what
+     * changed.
      *
      * This message tells us to resynchronize ourselves with the rest of the
      * world. We set both m_readyAssets and m_readyAlerts to false and query
@@ -319,73 +737,157 @@ void AlertStatsActor::startResynchronization()
      *  - outstanding alarms,
      *  - known assets.
      *
-     * Data will be collected through the mailbox and the flags will be
-     * reset on completion of subtasks. To prevent deadlocking on lost
+     * Data will be loaded into shadow collections through the mailbox and the
+     * flags will be reset on completion of subtasks. Meanwhile, the live data
+     * keeps being updated and its metrics published and refreshed, so they
+     * don't expire while resynchronizing. To prevent deadlocking on lost
      * answers, we force the flags back to true if the agent ticks while in this
      * state for too long.
      */
 
     log_info("Querying list of assets...");
-    m_assets.clear();
+    beginAssetLoad();
     zmsg_t* msg = zmsg_new();
     zmsg_addstr(msg, "GET");
     zmsg_addstr(msg, "");
     mlm_client_sendto(client(), "asset-agent", "ASSETS_IN_CONTAINER", nullptr, 5000, &msg);
 
     log_info("Querying details of all alerts...");
-    m_alerts.clear();
+    beginAlertLoad();
     msg = zmsg_new();
     zmsg_addstr(msg, "LIST");
     zmsg_addstr(msg, "ALL");
     mlm_client_sendto(client(), "fty-alert-list", "rfc-alerts-list", nullptr, 5000, &msg);
 
-    // Disarm agent until we have our data
+    // Bulk load until we have our data
     m_readyAssets = false;
     m_readyAlerts = false;
 
-    m_lastResync = zclock_mono() / 1000;
+    m_lastResync  = zclock_mono() / 1000;
+    m_resyncStart = zclock_usecs();
+    m_counters.resyncs++;
 }
+
 void AlertStatsActor::resynchronizationProgress()
 {
     /**
      * We enter this method everytime we've made progress on resynchronizing
-     * with the rest of the world. If we're done, publish all our metrics.
+     * with the rest of the world. If we're done, swap in the resynchronized
+     * data and publish the metrics that changed.
      */
     if (isReady()) {
         log_info("Agent is done resynchronizing data.");
+        finishAssetLoad(true);
+        finishAlertLoad(true);
         recomputeAlerts();
+
+        if (m_resyncStart) {
+            const int64_t duration = zclock_usecs() - m_resyncStart;
+            m_counters.resyncDuration.record(duration);
+            m_lastResyncDuration = duration / 1000;
+            m_lastResyncDone     = zclock_mono();
+            m_resyncStart        = 0;
+        }
     }
 }
 
 bool AlertStatsActor::tick()
 {
+    const int64_t start = zclock_usecs();
+
     purgeExpiredAlerts();
 
     log_info("Agent is ticking.");
 
+    // Retry asset queries we failed to send
+    if (!m_readyAssets) {
+        drainOutstandingAssetQueries();
+    }
+
     /**
      * As a safety precaution, unwedge the agent if it's stuck resynchronizing
      * for at least one complete poller timespan.
      */
     if (!isReady() && (zclock_mono() / 1000 > m_lastResync + m_pollerTimeout * 2)) {
         log_info("Agent was stuck resynchronizing data when entering tick, unwedging it...");
+        m_counters.resyncsUnwedged++;
+
+        // Not a successful resynchronization, don't account for it as such
+        m_resyncStart = 0;
+
+        // Keep the live data for whatever didn't finish resynchronizing
+        finishAssetLoad(m_readyAssets);
+        finishAlertLoad(m_readyAlerts);
         m_readyAssets = true;
         m_readyAlerts = true;
 
         resynchronizationProgress();
     }
 
-    // Refresh all alerts
+    // Publish pending updates, then refresh all alerts
+    flushMetrics(true);
+
+    /**
+     * Only visit metrics whose refresh deadline has passed. Entries whose
+     * metric got published since they were scheduled are simply moved to
+     * their new deadline.
+     */
     int64_t curClock = zclock_time() / 1000;
-    for (auto& i : m_alertCounts) {
-        if ((i.second.lastSent + m_metricTTL / 2) <= curClock) {
-            sendMetric(i, false);
+
+    while (!m_refreshSchedule.empty() && m_refreshSchedule.top().first <= curClock) {
+        AssetTopology::Id id = m_refreshSchedule.top().second;
+        m_refreshSchedule.pop();
+
+        AlertPublication& publication = m_topology.publication(id);
+        if (!publication.publishable) {
+            // No longer publishable, drop it from the schedule
+            publication.scheduled = false;
+            continue;
         }
+        if ((publication.lastSent + m_metricTTL / 2) <= curClock) {
+            sendMetric(id, true);
+        }
+        m_refreshSchedule.emplace(publication.lastSent + m_metricTTL / 2, id);
     }
 
+    publishHealth();
+
+    m_counters.tickDuration.record(zclock_usecs() - start);
     return true;
 }
 
+void AlertStatsActor::publishHealth()
+{
+    const int64_t  now      = zclock_mono();
+    const uint64_t messages = m_counters.streamAlerts + m_counters.streamAssets;
+    const int      ttl      = int(m_metricTTL);
+
+    auto write = [this, ttl](const char* type, int64_t value, const char* unit) {
+        m_writer.write(HEALTH_ASSET, type, std::to_string(value), unit, ttl);
+    };
+
+    // Rates and maximums are computed over the period since the previous publication
+    const int64_t elapsed = std::max(int64_t(1), now - m_lastHealth);
+    write(HEALTH_INGEST_RATE, int64_t(messages - m_lastHealthMessages) * 1000 / elapsed, "msg/s");
+    write(HEALTH_PUBLISH_LAG, m_publishLagMax, "ms");
+    write(HEALTH_QUEUE_LAG, m_queueLagMax, "ms");
+    write(HEALTH_QUEUE_DECODED, int64_t(m_decodeCounters.handedOver - m_decodedReceived), "");
+    write(HEALTH_QUEUE_WRITER, int64_t(m_writer.depth()), "");
+    write(HEALTH_ASSETS, int64_t(m_assets.size()), "");
+    write(HEALTH_ALERTS, int64_t(m_alerts.size()), "");
+
+    if (m_lastResyncDone) {
+        write(HEALTH_RESYNC_DURATION, m_lastResyncDuration, "ms");
+        write(HEALTH_RESYNC_AGE, (now - m_lastResyncDone) / 1000, "s");
+    }
+
+    m_lastHealth         = now;
+    m_nextHealth         = now + m_pollerTimeout;
+    m_lastHealthMessages = messages;
+    m_publishLagMax      = 0;
+    m_queueLagMax        = 0;
+}
+
 bool AlertStatsActor::handlePipe(zmsg_t* message)
 {
     bool  r             = true;
@@ -416,19 +918,27 @@ bool AlertStatsActor::handleMailbox(zmsg_t* message)
     // Resend all metrics
     if (streq(subject, "REPUBLISH")) {
         log_info("Republish query from '%s'.", sender);
+        m_counters.mailboxRepublish++;
         zmsg_t* reply = zmsg_new();
 
-        if (isReady()) {
-            recomputeAlerts();
-            zmsg_addstr(reply, "OK");
-        } else {
-            zmsg_addstr(reply, "RESYNC");
-        }
+        // Live data stays consistent while resynchronizing, no need to defer
+        recomputeAlerts(true);
+        m_writer.flush();
+        zmsg_addstr(reply, "OK");
 
         mlm_client_sendto(client(), sender, "REPUBLISH", NULL, 5000, &reply);
     }
+    // Report runtime counters
+    else if (streq(subject, "STATS")) {
+        m_counters.mailboxStats++;
+
+        zmsg_t* reply = statsReply();
+        mlm_client_sendto(client(), sender, "STATS", NULL, 5000, &reply);
+    }
     // Result of rfc-alerts-list query to fty-alert-list
     else if (streq(sender, "fty-alert-list") && streq(subject, "rfc-alerts-list")) {
+        m_counters.mailboxAlertsList++;
+
         // Pop return code
         actor_command = zmsg_popstr(message);
 
@@ -444,20 +954,32 @@ bool AlertStatsActor::handleMailbox(zmsg_t* message)
                 if (alertProto) {
                     log_debug("Injecting alert '%s' state %s severity %s.", fty_proto_rule(alertProto),
                         fty_proto_state(alertProto), fty_proto_severity(alertProto));
-                    processAlert(alertProto);
+                    m_counters.resyncAlerts++;
+                    if (m_readyAlerts) {
+                        processAlert(alertProto);
+                    } else {
+                        loadAlert(alertProto);
+                    }
                 } else {
                     log_error("Couldn't decode alert fty_proto_t message.");
+                    m_counters.decodeFailures++;
                 }
             }
 
             log_info("Finished resync of all alerts.");
             m_readyAlerts = true;
 
+            if (m_resyncStart) {
+                m_counters.resyncAlertsDuration.record(zclock_usecs() - m_resyncStart);
+            }
+
             resynchronizationProgress();
         }
     }
     // Result of ASSETS_IN_CONTAINER query to asset-agent
     else if (streq(sender, "asset-agent") && streq(subject, "ASSETS_IN_CONTAINER")) {
+        m_counters.mailboxAssetsList++;
+
         // Pop UUID
         actor_command = zmsg_popstr(message);
 
@@ -466,74 +988,210 @@ bool AlertStatsActor::handleMailbox(zmsg_t* message)
              * We have a list of asset names, but we need to query each asset
              * details in order to get the topology. Queue the queries to perform.
              */
+            m_assetQueries.clear();
+            m_assetQuerySendTimes.clear();
             m_outstandingAssetQueries = 0;
+            m_assetQueryWindow        = std::min(ASSET_QUERY_INITIAL_WINDOW, m_assetQueryWindowMax);
+            m_assetQueryBackoff       = 0;
+
             while (zmsg_size(message)) {
-                m_assetQueries.emplace_back(zmsg_popstr(message));
+                char* name = zmsg_popstr(message);
+                m_assetQueries.emplace_back(name);
+                zstr_free(&name);
             }
 
-            log_info("Received list of %d asset names, querying asset details...", m_assetQueries.size());
-            drainOutstandingAssetQueries();
+            log_info("Received list of %zu asset names, querying asset details...", m_assetQueries.size());
+            if (m_resyncStart) {
+                m_counters.resyncAssetListDuration.record(zclock_usecs() - m_resyncStart);
+            }
+            completeAssetQuery();
+            resynchronizationProgress();
         }
     }
     // Result of ASSET_DETAIL query to asset-agent
     else if (streq(sender, "asset-agent")) {
+        m_counters.mailboxAssetDetail++;
+
         // Pop UUID
         actor_command = zmsg_popstr(message);
 
-        if (actor_command && streq(actor_command, "_ASSET_DETAIL_RESULT")) {
+        if (actor_command && streq(actor_command, ASSET_DETAIL_RESULT)) {
             // Inject asset into ourselves
-            zmsg_t*      assetMsg   = zmsg_dup(message);
-            fty_proto_t* assetProto = fty_proto_decode(&assetMsg);
-            if (assetProto) {
-                log_debug("Injecting asset '%s'.", fty_proto_name(assetProto));
-                processAsset(assetProto);
-            } else {
-                log_error("Couldn't decode asset fty_proto_t message.");
-            }
+            zmsg_t* assetMsg = s_takeFrames(message);
+            injectAsset(&assetMsg);
 
-            --m_outstandingAssetQueries;
-            drainOutstandingAssetQueries();
-
-            if (m_outstandingAssetQueries == 0) {
-                log_info("Finished resync of all assets.");
-                m_readyAssets = true;
+            completeAssetQuery();
+            resynchronizationProgress();
+        } else if (actor_command && streq(actor_command, ASSET_DETAIL_BATCH_RESULT)) {
+            // Inject each asset into ourselves
+            while (zmsg_size(message)) {
+                zmsg_t* assetMsg = zmsg_popmsg(message);
+                injectAsset(&assetMsg);
             }
 
+            completeAssetQuery();
             resynchronizationProgress();
         } else {
             log_error("Unexpected mailbox message '%s' from '%s'.", subject, sender);
+            m_counters.mailboxOther++;
         }
     } else {
         log_error("Unexpected mailbox message '%s' from '%s'.", subject, sender);
+        m_counters.mailboxOther++;
     }
 
+    flushMetrics();
+
     zstr_free(&actor_command);
     return true;
 }
 
-bool AlertStatsActor::handleStream(zmsg_t* message)
+bool AlertStatsActor::handleDecoded()
 {
-    // On malamute streams we should receive only fty_proto messages
-    if (!fty_proto_is(message)) {
-        log_error("Received message is not a fty_proto message.");
-        return true;
+    /**
+     * Drain what the decode stage has already handed over, up to the batch
+     * size and time budget, then publish once for the whole batch. Messages
+     * left pending still hold back publication, within the publication latency
+     * bound.
+     */
+    zsock_t*      decoded  = zactor_sock(m_decoder);
+    const int64_t deadline = zclock_mono() + m_streamBatchBudget;
+    int64_t       batch    = 0;
+
+    do {
+        if (!ingestDecoded()) {
+            return false;
+        }
+        batch++;
+    } while (batch < m_streamBatch && (zsock_events(decoded) & ZMQ_POLLIN) && zclock_mono() < deadline);
+
+    m_counters.streamBatches++;
+    flushMetrics();
+
+    // Ticks are held off while messages keep coming, don't let the health metrics expire meanwhile
+    if (zclock_mono() >= m_nextHealth) {
+        publishHealth();
     }
 
-    zmsg_t*      message_dup      = zmsg_dup(message);
-    fty_proto_t* protocol_message = fty_proto_decode(&message_dup);
-    if (protocol_message == NULL) {
-        log_error("fty_proto_decode() failed, received message could not be parsed.");
-        return true;
+    return true;
+}
+
+bool AlertStatsActor::ingestDecoded()
+{
+    char*    command   = nullptr;
+    void*    object    = nullptr;
+    uint64_t timestamp = 0;
+
+    if (zsock_recv(zactor_sock(m_decoder), "sp8", &command, &object, &timestamp) == -1) {
+        return false;
+    }
+
+    // The decode stage only hands over assets and alerts, which the state holders take ownership of
+    fty_proto_t* proto = reinterpret_cast<fty_proto_t*>(object);
+
+    if (streq(command, "PROTO")) {
+        m_decodedReceived++;
+        m_queueLagMax = std::max(m_queueLagMax, (zclock_usecs() - int64_t(timestamp)) / 1000);
     }
 
-    if (fty_proto_id(protocol_message) == FTY_PROTO_ASSET) {
-        processAsset(protocol_message);
-    } else if (fty_proto_id(protocol_message) == FTY_PROTO_ALERT) {
-        processAlert(protocol_message);
+    if (!streq(command, "PROTO") || proto == nullptr) {
+        log_error("Unexpected decode stage message '%s'.", command);
+    } else if (fty_proto_id(proto) == FTY_PROTO_ASSET) {
+        m_counters.streamAssets++;
+        processAsset(proto);
     } else {
-        log_error("Unexpected fty_proto message.");
-        fty_proto_destroy(&protocol_message);
+        m_counters.streamAlerts++;
+        processAlert(proto);
     }
 
+    zstr_free(&command);
     return true;
 }
+
+/// Approximate heap footprint of a string (nothing if stored inline).
+static size_t s_stringBytes(const std::string& str)
+{
+    return str.capacity() > 15 ? str.capacity() + 1 : 0;
+}
+
+/// Approximate footprint of a node of a std::map or std::set, besides its value.
+static constexpr size_t NODE_BYTES = 4 * sizeof(void*);
+
+size_t AlertStatsActor::approximateMemory() const
+{
+    size_t bytes = 0;
+
+    for (const FtyAssetCollection::value_type& i : m_assets) {
+        bytes += NODE_BYTES + sizeof(i) + s_stringBytes(i.first) + s_stringBytes(i.second.parent) +
+                 s_stringBytes(i.second.type) + s_stringBytes(i.second.subtype);
+        for (const std::string& ancestor : i.second.ancestors) {
+            bytes += sizeof(ancestor) + s_stringBytes(ancestor);
+        }
+    }
+    for (const FtyAlertCollection::value_type& i : m_alerts) {
+        bytes += NODE_BYTES + sizeof(i) + s_stringBytes(i.first) + s_stringBytes(i.second.name);
+    }
+    for (const FtyAlertExpiries::value_type& i : m_alertExpiries) {
+        bytes += NODE_BYTES + sizeof(i) + s_stringBytes(i.second);
+    }
+
+    // Topology: interned names are stored twice (index and array)
+    for (AssetTopology::Id id = 0; id < m_topology.size(); id++) {
+        bytes += NODE_BYTES + 2 * (sizeof(std::string) + s_stringBytes(m_topology.name(id))) +
+                 sizeof(AssetTopology::Id) * 2 + sizeof(AlertCounters) + sizeof(AlertPublication);
+    }
+
+    return bytes;
+}
+
+zmsg_t* AlertStatsActor::statsReply() const
+{
+    zmsg_t* reply = zmsg_new();
+
+    auto add = [reply](const char* name, const std::string& value) {
+        zmsg_addstr(reply, name);
+        zmsg_addstr(reply, value.c_str());
+    };
+
+    add("messages.stream.alerts", std::to_string(m_counters.streamAlerts));
+    add("messages.stream.assets", std::to_string(m_counters.streamAssets));
+    add("messages.stream.other", std::to_string(m_decodeCounters.other));
+    add("messages.stream.filtered", std::to_string(m_decodeCounters.filtered));
+    add("messages.stream.batches", std::to_string(m_counters.streamBatches));
+    add("messages.mailbox.republish", std::to_string(m_counters.mailboxRepublish));
+    add("messages.mailbox.stats", std::to_string(m_counters.mailboxStats));
+    add("messages.mailbox.alerts_list", std::to_string(m_counters.mailboxAlertsList));
+    add("messages.mailbox.assets_list", std::to_string(m_counters.mailboxAssetsList));
+    add("messages.mailbox.asset_detail", std::to_string(m_counters.mailboxAssetDetail));
+    add("messages.mailbox.other", std::to_string(m_counters.mailboxOther));
+    add("messages.resync.alerts", std::to_string(m_counters.resyncAlerts));
+    add("messages.resync.assets", std::to_string(m_counters.resyncAssets));
+    add("messages.decode_failures", std::to_string(m_counters.decodeFailures + m_decodeCounters.decodeFailures));
+
+    add("recompute.duration", m_counters.recomputeDuration.str());
+    add("tick.duration", m_counters.tickDuration.str());
+    add("shm.writes", std::to_string(m_writer.writes()));
+    add("shm.write_failures", std::to_string(m_writer.failures()));
+    add("shm.superseded", std::to_string(m_writer.superseded()));
+    add("shm.queue_depth", std::to_string(m_writer.depth()));
+    add("shm.queue_depth_max", std::to_string(m_writer.maxDepth()));
+    add("shm.write_latency", m_writer.latency().str());
+
+    add("resync.count", std::to_string(m_counters.resyncs));
+    add("resync.unwedged", std::to_string(m_counters.resyncsUnwedged));
+    add("resync.in_progress", isReady() ? "0" : "1");
+    add("resync.asset_list.duration", m_counters.resyncAssetListDuration.str());
+    add("resync.assets.duration", m_counters.resyncAssetsDuration.str());
+    add("resync.alerts.duration", m_counters.resyncAlertsDuration.str());
+    add("resync.duration", m_counters.resyncDuration.str());
+
+    add("size.assets", std::to_string(m_assets.size()));
+    add("size.alerts", std::to_string(m_alerts.size()));
+    add("size.topology", std::to_string(m_topology.size()));
+    add("size.dirty_assets", std::to_string(m_dirtyAssets.size()));
+    add("size.refresh_schedule", std::to_string(m_refreshSchedule.size()));
+    add("size.asset_queries", std::to_string(m_assetQueries.size() + size_t(m_outstandingAssetQueries)));
+    add("memory.approximate", std::to_string(approximateMemory()));
+
+    return reply;
+}
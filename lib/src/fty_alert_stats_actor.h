@@ -20,8 +20,17 @@
 */
 
 #pragma once
+#include "fty_alert_stats_counters.h"
+#include "fty_alert_stats_decoder.h"
+#include "fty_alert_stats_server.h"
+#include "fty_alert_stats_topology.h"
+#include "fty_alert_stats_writer.h"
 #include "fty_proto_stateholders.h"
+#include <deque>
 #include <fty_common_mlm_agent.h>
+#include <functional>
+#include <queue>
+#include <set>
 
 /// Agent for publishing aggregate metric statitics for alerts by asset.
 ///
@@ -31,62 +40,82 @@
 /// count equal to the tally of all the alerts inside it (plus itself if
 /// applicable).
 ///
-/// The agent can also resynchronize itself with the rest of the system. It will
-/// enter a state where the agent ceases to publish metrics until the query of
-/// all the alerts and all the assets present in the system is complete (or if
-/// the operation times out at the next tick). It will then republish all its
-/// metrics with fresh data and resume normal operation.
+/// Metrics are only published for containers (datacenters, rooms, rows and
+/// racks by default), classified once when they are first seen.
+///
+/// Metric publication is coalesced: processing a message only marks the
+/// affected assets as dirty, and their metrics are published once the pending
+/// messages have been processed (or the publication latency bound expired).
+///
+/// Messages go through a pipeline of three stages, each in its own thread: the
+/// streams are decoded and filtered by a decode stage, then aggregated here,
+/// and the resulting metrics are written to shm by a writer stage.
+///
+/// The agent can also resynchronize itself with the rest of the system. It
+/// queries all the alerts and all the assets present in the system and bulk
+/// loads them into shadow collections, without running the incremental
+/// computations, while the live data keeps being updated and its metrics
+/// published. Once the query is complete (or if the operation times out at the
+/// next tick), the resynchronized data replaces the live data, the statistics
+/// are computed once and only the metrics that changed are republished.
 class AlertStatsActor : public mlm::MlmAgent, private FtyAlertStateHolder, private FtyAssetStateHolder
 {
 public:
-    AlertStatsActor(zsock_t* pipe, const char* endpoint, int64_t pollerTimeout, int64_t metricTTL);
-    virtual ~AlertStatsActor() = default;
+    AlertStatsActor(zsock_t* pipe, const AlertStatsActorParams& params);
+    virtual ~AlertStatsActor();
+
+    /// Main loop of the actor, also receiving the output of the decode stage.
+    /// Replaces mlm::MlmAgent::mainloop(), which must not be called.
+    void run();
 
 private:
-    struct AlertCount
-    {
-        AlertCount()
-            : critical(0)
-            , warning(0)
-            , lastSent(0)
-        {
-        }
-
-        int     critical;
-        int     warning;
-        int64_t lastSent;
-
-        AlertCount& operator+=(const AlertCount& ac)
-        {
-            critical += ac.critical;
-            warning += ac.warning;
-            lastSent = 0; // Invalidate lastSent
-            return *this;
-        }
-
-        AlertCount& operator=(const AlertCount& ac)
-        {
-            critical = ac.critical;
-            warning  = ac.warning;
-            lastSent = ac.lastSent;
-            return *this;
-        }
-    };
-
-    typedef std::map<std::string, AlertCount> AlertCounts;
-
-    virtual bool callbackAssetPre(fty_proto_t* asset) override;
-    virtual void callbackAssetPost(fty_proto_t* asset) override;
-    virtual bool callbackAlertPre(fty_proto_t* alert) override;
-
-    void recomputeAlerts();
-    bool recomputeAlert(fty_proto_t* alert, fty_proto_t* prevAlert);
-
-    void sendMetric(AlertCounts::value_type& metric, bool recursive = true);
+    /// Benchmarks drive the hot paths directly (see lib/bench).
+    friend class AlertStatsActorBench;
+
+    virtual bool callbackAssetPre(const std::string& name, const char* operation, const FtyAssetRecord& asset) override;
+    virtual void callbackAssetPost(
+        const std::string& name, const char* operation, const FtyAssetRecord& asset) override;
+    virtual bool callbackAlertPre(const std::string& rule, const FtyAlertRecord& alert) override;
+
+    void recomputeAlerts(bool republish = false);
+    bool recomputeAlert(const std::string& rule, const FtyAlertRecord& alert, const FtyAlertRecord* prevAlert);
+
+    typedef std::vector<AssetTopology::Id> Ancestors;
+
+    /// Min-heap of metric refresh deadlines of publishable assets.
+    typedef std::pair<int64_t, AssetTopology::Id> RefreshDeadline;
+    typedef std::priority_queue<RefreshDeadline, std::vector<RefreshDeadline>, std::greater<RefreshDeadline>>
+        RefreshSchedule;
+
+    /// Intern an asset referenced by the topology (as opposed to an alert).
+    AssetTopology::Id internAsset(const std::string& name);
+    /// Whether an asset is only known from the paths of other assets (no
+    /// record of it, and not deleted nor retired either).
+    bool              isImplied(const std::string& name) const;
+    AssetTopology::Id parentOf(const FtyAssetRecord& asset);
+    Ancestors         ancestorsOf(AssetTopology::Id id) const;
+    bool              closesLoop(AssetTopology::Id id, AssetTopology::Id parentId) const;
+    void              linkAncestors(const FtyAssetRecord& asset, bool moveTallies = true);
+    void              moveSubtree(AssetTopology::Id id, const Ancestors& prevAncestors, const Ancestors& newAncestors);
+
+    void markDirty(AssetTopology::Id id, bool recursive = true);
+    void flushMetrics(bool force = false);
+    void sendMetric(AssetTopology::Id id, bool force = false);
     void drainOutstandingAssetQueries();
+    void completeAssetQuery();
+    void injectAsset(zmsg_t** assetMsg);
     void startResynchronization();
     void resynchronizationProgress();
 
+    /// Approximate memory used by the collections (in bytes).
+    size_t approximateMemory() const;
+
+    /// Build the reply to a STATS request, as pairs of name and value frames.
+    zmsg_t* statsReply() const;
+
+    /// Publish the health metrics of the agent under HEALTH_ASSET.
+    void publishHealth();
+
     bool isReady() const
     {
         return m_readyAssets && m_readyAlerts;
@@ -94,20 +123,73 @@ private:
 
     virtual bool tick() override;
     virtual bool handlePipe(zmsg_t* message) override;
-    virtual bool handleStream(zmsg_t* message) override;
     virtual bool handleMailbox(zmsg_t* message) override;
 
-    AlertCounts              m_alertCounts;
+    /// Ingest a batch of the objects handed over by the decode stage.
+    bool handleDecoded();
+
+    /// Ingest the next object handed over by the decode stage.
+    bool ingestDecoded();
+
+    AssetTopology            m_topology;
+    std::set<std::string>    m_retiredAssets;
+    Ancestors                m_dirtyAssets;
+    int64_t                  m_dirtySince;
+    RefreshSchedule          m_refreshSchedule;
     std::vector<std::string> m_assetQueries;
+    std::deque<int64_t>      m_assetQuerySendTimes;
     int                      m_outstandingAssetQueries;
+    int                      m_assetQueryWindow;
+    int64_t                  m_assetQueryBackoff;
     bool                     m_readyAssets;
     bool                     m_readyAlerts;
     int64_t                  m_lastResync;
+    int64_t                  m_resyncStart;
+    AlertStatsCounters       m_counters;
+    int64_t                  m_lastHealth;
+    uint64_t                 m_lastHealthMessages;
+    int64_t                  m_nextHealth;
+    int64_t                  m_publishLagMax;
+    int64_t                  m_queueLagMax;
+    uint64_t                 m_decodedReceived;
+    int64_t                  m_lastResyncDuration;
+    int64_t                  m_lastResyncDone;
+
+    AlertMetrics    m_metrics;
+    AlertCategories m_publishedCategories;
+    AssetClassifier m_classifier;
 
     int64_t m_metricTTL;
     int64_t m_pollerTimeout;
+    int64_t m_publishLatency;
+    int64_t m_streamBatch;
+    int64_t m_streamBatchBudget;
+    int64_t m_assetQueryBatch;
+    int     m_assetQueryWindowMax;
+
+    DecodeStageCounters m_decodeCounters;
+    zactor_t*           m_decoder;
+    MetricWriter        m_writer;
+
+    constexpr static const char* STREAM_CLIENT_ADDRESS      = "fty-alert-stats-stream";
+    constexpr static const char* ASSET_DETAIL_RESULT        = "_ASSET_DETAIL_RESULT";
+    constexpr static const char* ASSET_DETAIL_BATCH_RESULT  = "_ASSET_DETAIL_BATCH_RESULT";
+    constexpr static int         ASSET_QUERY_INITIAL_WINDOW = 32;
+    constexpr static int64_t     ASSET_QUERY_LATENCY_TARGET = 1000; // msec.
 
 public:
     constexpr static const char* WARNING_METRIC  = "alerts.active.warning";
     constexpr static const char* CRITICAL_METRIC = "alerts.active.critical";
+
+    /// Pseudo-asset under which the agent publishes its own health metrics.
+    constexpr static const char* HEALTH_ASSET           = "fty-alert-stats";
+    constexpr static const char* HEALTH_INGEST_RATE     = "health.ingest.rate";
+    constexpr static const char* HEALTH_PUBLISH_LAG     = "health.publish.lag";
+    constexpr static const char* HEALTH_QUEUE_LAG       = "health.queue.lag";
+    constexpr static const char* HEALTH_QUEUE_DECODED   = "health.queue.decoded";
+    constexpr static const char* HEALTH_QUEUE_WRITER    = "health.queue.writer";
+    constexpr static const char* HEALTH_ASSETS          = "health.assets";
+    constexpr static const char* HEALTH_ALERTS          = "health.alerts";
+    constexpr static const char* HEALTH_RESYNC_DURATION = "health.resync.duration";
+    constexpr static const char* HEALTH_RESYNC_AGE      = "health.resync.age";
 };
@@ -0,0 +1,70 @@
+/*  =========================================================================
+    fty_alert_stats_classifier - Publishable asset classifier
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "fty_alert_stats_classifier.h"
+#include <algorithm>
+#include <sstream>
+
+AssetClassifier::AssetClassifier(const std::vector<std::string>& prefixes, const std::vector<std::string>& types)
+    : m_prefixes(prefixes)
+    , m_types(types)
+{
+}
+
+bool AssetClassifier::classify(const std::string& name) const
+{
+    return std::any_of(m_prefixes.begin(), m_prefixes.end(), [&name](const std::string& prefix) {
+        return name.compare(0, prefix.size(), prefix) == 0;
+    });
+}
+
+bool AssetClassifier::classify(const std::string& name, const std::string& type, const std::string& subtype) const
+{
+    if (classify(name)) {
+        return true;
+    }
+
+    return std::any_of(m_types.begin(), m_types.end(), [&type, &subtype](const std::string& t) {
+        return t == type || t == subtype;
+    });
+}
+
+std::vector<std::string> AssetClassifier::parseList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream       ss(list);
+    std::string              item;
+
+    while (std::getline(ss, item, ',')) {
+        const size_t first = item.find_first_not_of(" \t");
+        const size_t last  = item.find_last_not_of(" \t");
+        if (first != std::string::npos) {
+            items.push_back(item.substr(first, last - first + 1));
+        }
+    }
+
+    return items;
+}
+
+std::vector<std::string> AssetClassifier::defaultPrefixes()
+{
+    return {"datacenter-", "room-", "row-", "rack-"};
+}
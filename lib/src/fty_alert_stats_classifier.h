@@ -0,0 +1,53 @@
+/*  =========================================================================
+    fty_alert_stats_classifier - Publishable asset classifier
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <string>
+#include <vector>
+
+/// Classifier of the assets whose metrics are published.
+///
+/// Assets are classified by name prefix (e.g. "rack-") or by type or subtype
+/// (e.g. "rack"). Classifying is a scan of short lists, meant to be done once
+/// per asset when it is first seen or its record changes, not on every
+/// publication.
+class AssetClassifier
+{
+public:
+    AssetClassifier() = default;
+    AssetClassifier(const std::vector<std::string>& prefixes, const std::vector<std::string>& types);
+
+    /// Check whether an asset is publishable from its name alone.
+    bool classify(const std::string& name) const;
+
+    /// Check whether an asset is publishable from its name, type and subtype.
+    bool classify(const std::string& name, const std::string& type, const std::string& subtype) const;
+
+    /// Parse a comma-separated list, ignoring surrounding whitespace and empty items.
+    static std::vector<std::string> parseList(const std::string& list);
+
+    /// Name prefixes published by default: datacenters, rooms, rows and racks.
+    static std::vector<std::string> defaultPrefixes();
+
+private:
+    std::vector<std::string> m_prefixes;
+    std::vector<std::string> m_types;
+};
@@ -0,0 +1,55 @@
+/*  =========================================================================
+    fty_alert_stats_counters - Runtime performance counters
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "fty_alert_stats_counters.h"
+#include <algorithm>
+
+void DurationHistogram::record(int64_t usecs)
+{
+    const uint64_t duration = usecs > 0 ? uint64_t(usecs) : 0;
+
+    // Bucket i holds durations in ]2^(i-1), 2^i], bucket 0 holds 0 and 1
+    size_t bucket = duration > 1 ? size_t(64 - __builtin_clzll(duration - 1)) : 0;
+    m_buckets[std::min(bucket, BUCKETS - 1)]++;
+
+    m_count++;
+    m_sum += duration;
+    m_max = std::max(m_max, duration);
+}
+
+std::string DurationHistogram::str() const
+{
+    std::string r = "count=" + std::to_string(m_count) + " sum=" + std::to_string(m_sum) +
+                    " max=" + std::to_string(m_max) + " buckets=";
+
+    bool first = true;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        if (m_buckets[i]) {
+            if (!first) {
+                r += ",";
+            }
+            r += std::to_string(uint64_t(1) << i) + ":" + std::to_string(m_buckets[i]);
+            first = false;
+        }
+    }
+
+    return r;
+}
@@ -0,0 +1,84 @@
+/*  =========================================================================
+    fty_alert_stats_counters - Runtime performance counters
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+
+/// Histogram of durations, in power-of-two buckets of microseconds.
+///
+/// Recording a duration is a couple of arithmetic operations, cheap enough
+/// to be done on every message.
+class DurationHistogram
+{
+public:
+    /// Record a duration (in usecs.).
+    void record(int64_t usecs);
+
+    uint64_t count() const
+    {
+        return m_count;
+    }
+
+    /// Textual form: "count=<n> sum=<usecs> max=<usecs> buckets=<bound>:<n>,...",
+    /// where each non-empty bucket counts the durations up to its bound (in
+    /// usecs.) and above the previous one.
+    std::string str() const;
+
+private:
+    constexpr static size_t BUCKETS = 40;
+
+    std::array<uint64_t, BUCKETS> m_buckets{};
+    uint64_t                      m_count = 0;
+    uint64_t                      m_sum   = 0;
+    uint64_t                      m_max   = 0;
+};
+
+/// Runtime counters of the agent, reported by the STATS mailbox request.
+struct AlertStatsCounters
+{
+    // Messages ingested
+    uint64_t streamAlerts       = 0;
+    uint64_t streamAssets       = 0;
+    uint64_t streamBatches      = 0;
+    uint64_t mailboxRepublish   = 0;
+    uint64_t mailboxStats       = 0;
+    uint64_t mailboxAlertsList  = 0;
+    uint64_t mailboxAssetsList  = 0;
+    uint64_t mailboxAssetDetail = 0;
+    uint64_t mailboxOther       = 0;
+    uint64_t resyncAlerts       = 0;
+    uint64_t resyncAssets       = 0;
+    uint64_t decodeFailures     = 0;
+
+    // Computations and publication
+    DurationHistogram recomputeDuration;
+    DurationHistogram tickDuration;
+
+    // Resynchronizations, each phase timed from the start of the resync
+    uint64_t          resyncs         = 0;
+    uint64_t          resyncsUnwedged = 0;
+    DurationHistogram resyncAssetListDuration;
+    DurationHistogram resyncAssetsDuration;
+    DurationHistogram resyncAlertsDuration;
+    DurationHistogram resyncDuration;
+};
@@ -0,0 +1,105 @@
+/*  =========================================================================
+    fty_alert_stats_decoder - Decode stage of the ingest pipeline
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "fty_alert_stats_decoder.h"
+#include <fty_log.h>
+#include <fty_proto.h>
+
+/// Decode a stream message, nullptr if it is not worth handing over.
+static fty_proto_t* s_decode(zmsg_t** message, DecodeStageCounters& counters)
+{
+    // On malamute streams we should receive only fty_proto messages
+    if (!fty_proto_is(*message)) {
+        log_error("Received message is not a fty_proto message.");
+        counters.decodeFailures++;
+        zmsg_destroy(message);
+        return nullptr;
+    }
+
+    fty_proto_t* proto = fty_proto_decode(message);
+
+    if (proto == nullptr) {
+        log_error("fty_proto_decode() failed, received message could not be parsed.");
+        counters.decodeFailures++;
+    } else if (fty_proto_id(proto) == FTY_PROTO_ASSET) {
+        // Inventory updates never touch the topology
+        const char* operation = fty_proto_operation(proto);
+        if (operation && streq(operation, FTY_PROTO_ASSET_OP_INVENTORY)) {
+            counters.filtered++;
+            fty_proto_destroy(&proto);
+        }
+    } else if (fty_proto_id(proto) != FTY_PROTO_ALERT) {
+        log_error("Unexpected fty_proto message.");
+        counters.other++;
+        fty_proto_destroy(&proto);
+    }
+
+    return proto;
+}
+
+void fty_alert_stats_decoder(zsock_t* pipe, void* args)
+{
+    DecodeStageArgs*     stageArgs = reinterpret_cast<DecodeStageArgs*>(args);
+    mlm_client_t*        client    = stageArgs->client;
+    DecodeStageCounters& counters  = *stageArgs->counters;
+
+    zpoller_t* poller = zpoller_new(pipe, mlm_client_msgpipe(client), nullptr);
+    zsock_signal(pipe, 0);
+
+    bool keepGoing = true;
+    while (keepGoing) {
+        void* which = zpoller_wait(poller, -1);
+
+        if (which == pipe) {
+            char* command = zstr_recv(pipe);
+
+            if (!command || streq(command, "$TERM")) {
+                keepGoing = false;
+            } else if (streq(command, "STOP")) {
+                zsock_send(pipe, "sp8", "STOPPED", nullptr, uint64_t(0));
+                keepGoing = false;
+            } else {
+                log_error("Unexpected decode stage command '%s'.", command);
+            }
+
+            zstr_free(&command);
+        } else if (which) {
+            zmsg_t* message = mlm_client_recv(client);
+
+            if (message && streq(mlm_client_command(client), "STREAM DELIVER")) {
+                fty_proto_t* proto = s_decode(&message, counters);
+                if (proto) {
+                    // Counted first, so the core never receives more than were handed over
+                    counters.handedOver++;
+                    zsock_send(pipe, "sp8", "PROTO", proto, uint64_t(zclock_usecs()));
+                }
+            }
+
+            zmsg_destroy(&message);
+        } else {
+            // Interrupted
+            keepGoing = false;
+        }
+    }
+
+    zpoller_destroy(&poller);
+    mlm_client_destroy(&client);
+}
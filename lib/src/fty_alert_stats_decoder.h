@@ -0,0 +1,58 @@
+/*  =========================================================================
+    fty_alert_stats_decoder - Decode stage of the ingest pipeline
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <malamute.h>
+
+/// Counters of the decode stage, read by the aggregation core.
+struct DecodeStageCounters
+{
+    std::atomic<uint64_t> decodeFailures{0};
+    std::atomic<uint64_t> other{0};
+    std::atomic<uint64_t> filtered{0};
+
+    /// Objects handed over to the aggregation core.
+    std::atomic<uint64_t> handedOver{0};
+};
+
+/// Arguments of the decode stage.
+struct DecodeStageArgs
+{
+    /// Client connected and subscribed to the streams, owned by the stage.
+    mlm_client_t* client;
+
+    DecodeStageCounters* counters;
+};
+
+/// Decode stage of the ingest pipeline, as a zactor_fn.
+///
+/// The stage runs in its own thread and consumes the streams through its own
+/// malamute client. Each message is decoded and filtered there, then handed
+/// over to the aggregation core over the actor pipe as ("PROTO", pointer, time
+/// of the hand-over in usecs.), the core taking ownership of the fty_proto_t
+/// object. The high water mark of the pipe bounds the hand-over queue: once it
+/// is full, the stage blocks and messages queue up in the broker instead.
+///
+/// On "STOP", the stage replies ("STOPPED", NULL, 0) and hands nothing more
+/// over, so the core knows when it has received all the objects in flight.
+void fty_alert_stats_decoder(zsock_t* pipe, void* args);
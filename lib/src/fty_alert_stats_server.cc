@@ -32,8 +32,8 @@ void fty_alert_stats_server(zsock_t* pipe, void* args)
     const AlertStatsActorParams* params = reinterpret_cast<const AlertStatsActorParams*>(args);
 
     try {
-        AlertStatsActor alertStatsServer(pipe, params->endpoint.c_str(), params->pollerTimeout, params->metricTTL);
-        alertStatsServer.mainloop();
+        AlertStatsActor alertStatsServer(pipe, *params);
+        alertStatsServer.run();
     } catch (std::runtime_error& e) {
         log_error("std::runtime_error exception caught, aborting actor (most likely died while initializing).");
     } catch (...) {
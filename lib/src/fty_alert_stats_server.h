@@ -20,6 +20,8 @@
 */
 
 #pragma once
+#include "fty_alert_stats_classifier.h"
+#include "fty_alert_stats_topology.h"
 #include <czmq.h>
 #include <string>
 
@@ -28,6 +30,18 @@ struct AlertStatsActorParams
     std::string endpoint;
     int64_t     pollerTimeout;
     int64_t     metricTTL;
+    int64_t     publishLatency    = 1000;
+    int64_t     streamBatch       = 256;
+    int64_t     streamBatchBudget = 50; // msec.
+    int64_t     assetQueryBatch   = 1;
+    int64_t     assetQueryWindow  = 256;
+
+    /// Metrics published for each publishable asset.
+    AlertMetrics metrics = defaultAlertMetrics();
+
+    /// Publishable assets, by name prefix or by type or subtype.
+    std::vector<std::string> publishPrefixes = AssetClassifier::defaultPrefixes();
+    std::vector<std::string> publishTypes;
 };
 
 //  This is the actor constructor as zactor_fn
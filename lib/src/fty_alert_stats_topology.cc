@@ -0,0 +1,171 @@
+/*  =========================================================================
+    fty_alert_stats_topology - Compact asset topology graph
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "fty_alert_stats_topology.h"
+#include <sstream>
+
+static const char* s_categoryNames[] = {"active.critical", "active.warning", "active.info", "acknowledged.critical",
+    "acknowledged.warning", "acknowledged.info"};
+
+static_assert(sizeof(s_categoryNames) / sizeof(*s_categoryNames) == size_t(AlertCategory::COUNT),
+    "Alert category names out of sync");
+
+AlertCategory parseAlertCategory(const std::string& name)
+{
+    for (size_t i = 0; i < size_t(AlertCategory::COUNT); i++) {
+        if (name == s_categoryNames[i]) {
+            return AlertCategory(i);
+        }
+    }
+    return AlertCategory::COUNT;
+}
+
+const char* alertCategoryName(AlertCategory category)
+{
+    return category < AlertCategory::COUNT ? s_categoryNames[size_t(category)] : "unknown";
+}
+
+int32_t AlertCounters::sum(AlertCategories categories) const
+{
+    int32_t r = 0;
+    for (size_t i = 0; i < LANES; i++) {
+        if (categories & (AlertCategories(1) << i)) {
+            r += values[i];
+        }
+    }
+    return r;
+}
+
+bool AlertCounters::equal(const AlertCounters& ac, AlertCategories categories) const
+{
+    for (size_t i = 0; i < LANES; i++) {
+        if ((categories & (AlertCategories(1) << i)) && values[i] != ac.values[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string AlertCounters::str() const
+{
+    std::ostringstream ss;
+    ss << "(";
+    for (size_t i = 0; i < size_t(AlertCategory::COUNT); i++) {
+        ss << (i ? " " : "") << values[i];
+    }
+    ss << ")";
+    return ss.str();
+}
+
+bool parseAlertMetric(const std::string& name, const std::string& categories, AlertMetric& metric)
+{
+    metric.name       = name;
+    metric.categories = 0;
+
+    std::istringstream ss(categories);
+    std::string        category;
+
+    while (std::getline(ss, category, ',')) {
+        // Trim surrounding whitespace
+        const size_t first = category.find_first_not_of(" \t");
+        const size_t last  = category.find_last_not_of(" \t");
+        if (first == std::string::npos) {
+            continue;
+        }
+
+        AlertCategory c = parseAlertCategory(category.substr(first, last - first + 1));
+        if (c == AlertCategory::COUNT) {
+            return false;
+        }
+        metric.categories |= alertCategoryBit(c);
+    }
+
+    return !name.empty() && metric.categories != 0;
+}
+
+AlertMetrics defaultAlertMetrics()
+{
+    return {{"alerts.active.warning", alertCategoryBit(AlertCategory::ACTIVE_WARNING)},
+        {"alerts.active.critical", alertCategoryBit(AlertCategory::ACTIVE_CRITICAL)}};
+}
+
+AssetTopology::Id AssetTopology::intern(const std::string& name)
+{
+    auto r = m_ids.emplace(name, Id(m_names.size()));
+
+    if (r.second) {
+        m_names.push_back(name);
+        m_parents.push_back(NONE);
+        m_counters.emplace_back();
+        m_publications.emplace_back();
+    }
+
+    return r.first->second;
+}
+
+AssetTopology::Id AssetTopology::find(const std::string& name) const
+{
+    auto it = m_ids.find(name);
+    return it != m_ids.end() ? it->second : NONE;
+}
+
+void AssetTopology::clear()
+{
+    m_ids.clear();
+    m_names.clear();
+    m_parents.clear();
+    m_counters.clear();
+    m_publications.clear();
+}
+
+void AssetTopology::aggregate()
+{
+    const Id n = Id(m_names.size());
+
+    // Count the children of each asset, leaves are ready to be propagated
+    std::vector<Id> pendingChildren(n, 0);
+    for (Id id = 0; id < n; id++) {
+        if (m_parents[id] != NONE) {
+            pendingChildren[m_parents[id]]++;
+        }
+    }
+
+    std::vector<Id> ready;
+    ready.reserve(n);
+    for (Id id = 0; id < n; id++) {
+        if (pendingChildren[id] == 0) {
+            ready.push_back(id);
+        }
+    }
+
+    // An asset becomes ready once all of its children have been added to it
+    for (size_t i = 0; i < ready.size(); i++) {
+        Id id     = ready[i];
+        Id parent = m_parents[id];
+
+        if (parent != NONE) {
+            m_counters[parent] += m_counters[id];
+            if (--pendingChildren[parent] == 0) {
+                ready.push_back(parent);
+            }
+        }
+    }
+}
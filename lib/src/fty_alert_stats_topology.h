@@ -0,0 +1,234 @@
+/*  =========================================================================
+    fty_alert_stats_topology - Compact asset topology graph
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Categories of alerts tallied for each asset, by state and severity.
+enum class AlertCategory : uint8_t
+{
+    ACTIVE_CRITICAL,
+    ACTIVE_WARNING,
+    ACTIVE_INFO,
+    ACKNOWLEDGED_CRITICAL,
+    ACKNOWLEDGED_WARNING,
+    ACKNOWLEDGED_INFO,
+    COUNT
+};
+
+/// Set of alert categories, one bit per category.
+typedef uint32_t AlertCategories;
+
+/// Parse a category name (e.g. "active.critical"), COUNT if unknown.
+AlertCategory parseAlertCategory(const std::string& name);
+const char*   alertCategoryName(AlertCategory category);
+
+constexpr AlertCategories alertCategoryBit(AlertCategory category)
+{
+    return AlertCategories(1) << unsigned(category);
+}
+
+/// Vector of alert counters, one per category.
+///
+/// The counters are padded to a fixed number of lanes, with the unused ones
+/// kept at zero, so that adding or subtracting vectors is a fixed-length loop
+/// compiled down to a couple of vector instructions. Adding a category costs
+/// nothing more when propagating tallies.
+struct AlertCounters
+{
+    constexpr static size_t LANES = 8;
+    static_assert(size_t(AlertCategory::COUNT) <= LANES, "Too many alert categories");
+
+    std::array<int32_t, LANES> values{};
+
+    int32_t& operator[](AlertCategory category)
+    {
+        return values[size_t(category)];
+    }
+
+    int32_t operator[](AlertCategory category) const
+    {
+        return values[size_t(category)];
+    }
+
+    AlertCounters& operator+=(const AlertCounters& ac)
+    {
+        // Work on a copy, as the operands might alias and prevent vectorization
+        const std::array<int32_t, LANES> other = ac.values;
+        for (size_t i = 0; i < LANES; i++) {
+            values[i] += other[i];
+        }
+        return *this;
+    }
+
+    AlertCounters& operator-=(const AlertCounters& ac)
+    {
+        // Work on a copy, as the operands might alias and prevent vectorization
+        const std::array<int32_t, LANES> other = ac.values;
+        for (size_t i = 0; i < LANES; i++) {
+            values[i] -= other[i];
+        }
+        return *this;
+    }
+
+    bool operator==(const AlertCounters& ac) const
+    {
+        return values == ac.values;
+    }
+
+    bool operator!=(const AlertCounters& ac) const
+    {
+        return values != ac.values;
+    }
+
+    /// Check whether all counters are zero.
+    bool empty() const
+    {
+        return *this == AlertCounters();
+    }
+
+    /// Sum of the counters of a set of categories.
+    int32_t sum(AlertCategories categories) const;
+
+    /// Check whether the counters of a set of categories are equal.
+    bool equal(const AlertCounters& ac, AlertCategories categories) const;
+
+    /// Counters formatted for logging, in category order.
+    std::string str() const;
+};
+
+/// Published metric, the sum of the counters of a set of categories.
+struct AlertMetric
+{
+    std::string     name;
+    AlertCategories categories;
+};
+
+typedef std::vector<AlertMetric> AlertMetrics;
+
+/// Parse a metric definition, given as a comma-separated list of categories.
+bool parseAlertMetric(const std::string& name, const std::string& categories, AlertMetric& metric);
+
+/// Metrics published by default: alerts.active.warning and alerts.active.critical.
+AlertMetrics defaultAlertMetrics();
+
+/// Publication state of the metrics of an asset.
+struct AlertPublication
+{
+    AlertCounters sent;
+    int64_t       lastSent    = 0;
+    bool          publishable = false;
+    bool          published   = false;
+    bool          dirty       = false;
+    bool          scheduled   = false;
+
+    /// Check whether a tally differs from what was last published, for some categories.
+    bool changed(const AlertCounters& counters, AlertCategories categories) const
+    {
+        return !published || !counters.equal(sent, categories);
+    }
+};
+
+/// Compact graph of the asset topology.
+///
+/// Asset names are interned into dense integer identifiers, with the parent of
+/// each asset and its alert tally stored in flat arrays indexed by identifier.
+/// Walking up the topology is therefore a handful of array loads, without any
+/// string comparison or hash lookup. The publication state of the metrics is
+/// kept apart, so that propagating tallies only touches the tallies.
+///
+/// Identifiers are never recycled until the graph is cleared.
+class AssetTopology
+{
+public:
+    typedef uint32_t Id;
+
+    /// Identifier of no asset (parent of top-level assets).
+    constexpr static Id NONE = UINT32_MAX;
+
+    /// Get the identifier of an asset, allocating it if needed.
+    Id intern(const std::string& name);
+
+    /// Get the identifier of an asset, or NONE if unknown.
+    Id find(const std::string& name) const;
+
+    /// Forget all assets.
+    void clear();
+
+    /// Propagate the tallies up the topology, from children to parents.
+    ///
+    /// On entry, the tally of each asset holds only its own alerts. On return,
+    /// it holds the alerts of its whole subtree. Each asset is visited once,
+    /// after all of its children, so this is linear in the number of assets.
+    /// Assets caught in a parent loop are not propagated any further.
+    void aggregate();
+
+    size_t size() const
+    {
+        return m_names.size();
+    }
+
+    const std::string& name(Id id) const
+    {
+        return m_names[id];
+    }
+
+    Id parent(Id id) const
+    {
+        return m_parents[id];
+    }
+
+    void setParent(Id id, Id parent)
+    {
+        m_parents[id] = parent;
+    }
+
+    AlertCounters& counters(Id id)
+    {
+        return m_counters[id];
+    }
+
+    const AlertCounters& counters(Id id) const
+    {
+        return m_counters[id];
+    }
+
+    AlertPublication& publication(Id id)
+    {
+        return m_publications[id];
+    }
+
+    const AlertPublication& publication(Id id) const
+    {
+        return m_publications[id];
+    }
+
+private:
+    std::unordered_map<std::string, Id> m_ids;
+    std::vector<std::string>            m_names;
+    std::vector<Id>                     m_parents;
+    std::vector<AlertCounters>          m_counters;
+    std::vector<AlertPublication>       m_publications;
+};
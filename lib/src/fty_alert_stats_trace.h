@@ -0,0 +1,50 @@
+/*  =========================================================================
+    fty_alert_stats_trace - Trace logging for hot paths
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include <fty_log.h>
+
+/// Trace logging for hot paths.
+///
+/// log_trace evaluates its arguments (and calls into the logger) even when
+/// trace logging is disabled. log_trace_lazy only evaluates them if trace
+/// logging is enabled, and is compiled out entirely when
+/// FTY_ALERT_STATS_NO_TRACE is defined (see the ENABLE_HOT_PATH_TRACE build
+/// option). Compiled out traces are still type checked.
+#define log_trace_lazy_on(...)                                                                                         \
+    do {                                                                                                               \
+        if (ftylog_getInstance()->isLogTrace()) {                                                                      \
+            log_trace(__VA_ARGS__);                                                                                    \
+        }                                                                                                              \
+    } while (0)
+
+#define log_trace_lazy_off(...)                                                                                        \
+    do {                                                                                                               \
+        if (false) {                                                                                                   \
+            log_trace(__VA_ARGS__);                                                                                    \
+        }                                                                                                              \
+    } while (0)
+
+#ifdef FTY_ALERT_STATS_NO_TRACE
+#define log_trace_lazy log_trace_lazy_off
+#else
+#define log_trace_lazy log_trace_lazy_on
+#endif
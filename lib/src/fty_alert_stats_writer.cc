@@ -0,0 +1,139 @@
+/*  =========================================================================
+    fty_alert_stats_writer - Writer stage of the pipeline
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#include "fty_alert_stats_writer.h"
+#include <algorithm>
+#include <fty_shm.h>
+
+/// Key of a metric in the table of pending writes.
+static std::string s_key(const std::string& asset, const std::string& type)
+{
+    std::string key;
+    key.reserve(asset.size() + type.size() + 1);
+    key.append(asset).append(1, '\0').append(type);
+    return key;
+}
+
+MetricWriter::MetricWriter(size_t capacity)
+    : m_capacity(std::max(size_t(1), capacity))
+    , m_thread(&MetricWriter::run, this)
+{
+}
+
+MetricWriter::~MetricWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeup.notify_one();
+    m_thread.join();
+}
+
+void MetricWriter::write(
+    const std::string& asset, const std::string& type, const std::string& value, const std::string& unit, int ttl)
+{
+    std::string                  key = s_key(asset, type);
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto it = m_pending.find(key);
+    if (it != m_pending.end()) {
+        // Not written yet, only the latest value matters
+        it->second.value = value;
+        it->second.unit  = unit;
+        it->second.ttl   = ttl;
+        m_superseded++;
+        return;
+    }
+
+    // Backpressure: wait for the writer thread to make room
+    m_progress.wait(lock, [this]() {
+        return m_pending.size() < m_capacity;
+    });
+
+    m_pending.emplace(key, Write{asset, type, value, unit, ttl, Clock::now()});
+    m_order.push_back(std::move(key));
+    m_maxDepth = std::max(m_maxDepth, m_pending.size());
+
+    lock.unlock();
+    m_wakeup.notify_one();
+}
+
+void MetricWriter::flush()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_progress.wait(lock, [this]() {
+        return m_pending.empty() && !m_busy;
+    });
+}
+
+size_t MetricWriter::depth() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending.size();
+}
+
+size_t MetricWriter::maxDepth() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_maxDepth;
+}
+
+DurationHistogram MetricWriter::latency() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_latency;
+}
+
+void MetricWriter::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_wakeup.wait(lock, [this]() {
+            return m_stop || !m_order.empty();
+        });
+
+        // Pending writes are done before stopping
+        if (m_order.empty()) {
+            break;
+        }
+
+        auto  it    = m_pending.find(m_order.front());
+        Write write = std::move(it->second);
+        m_pending.erase(it);
+        m_order.pop_front();
+        m_busy = true;
+        lock.unlock();
+
+        if (fty::shm::write_metric(write.asset, write.type, write.value, write.unit, write.ttl) != 0) {
+            m_failures++;
+        }
+        m_writes++;
+
+        const auto done = Clock::now();
+
+        lock.lock();
+        m_latency.record(std::chrono::duration_cast<std::chrono::microseconds>(done - write.queued).count());
+        m_busy = false;
+        m_progress.notify_all();
+    }
+}
@@ -0,0 +1,121 @@
+/*  =========================================================================
+    fty_alert_stats_writer - Writer stage of the pipeline
+
+    Copyright (C) 2014 - 2020 Eaton
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    =========================================================================
+*/
+
+#pragma once
+#include "fty_alert_stats_counters.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+/// Writer stage of the pipeline, writing metrics to shm from its own thread.
+///
+/// The aggregation core only queues the writes, so it does not wait on the
+/// filesystem. Pending writes are kept in a table holding the latest value of
+/// each (asset, metric): a value queued while the previous one is still
+/// pending supersedes it in place, keeping its turn, so a metric updated many
+/// times in a burst is written once. Metrics are written in the order they
+/// were first queued.
+///
+/// The table is bounded: once it holds too many metrics, write() blocks until
+/// the writer thread catches up, except to supersede a pending value.
+class MetricWriter
+{
+public:
+    explicit MetricWriter(size_t capacity = DEFAULT_CAPACITY);
+
+    /// Do the pending writes, then stop the writer thread.
+    ~MetricWriter();
+
+    MetricWriter(const MetricWriter&) = delete;
+    MetricWriter& operator=(const MetricWriter&) = delete;
+
+    /// Queue a metric write, superseding the pending value of the metric (if any).
+    void write(const std::string& asset, const std::string& type, const std::string& value, const std::string& unit,
+        int ttl);
+
+    /// Wait until all the queued writes are done.
+    void flush();
+
+    /// Number of writes done (failed ones included).
+    uint64_t writes() const
+    {
+        return m_writes;
+    }
+
+    /// Number of writes failed.
+    uint64_t failures() const
+    {
+        return m_failures;
+    }
+
+    /// Number of values superseded before being written.
+    uint64_t superseded() const
+    {
+        return m_superseded;
+    }
+
+    /// Number of metrics pending.
+    size_t depth() const;
+
+    /// Highest number of metrics pending so far.
+    size_t maxDepth() const;
+
+    /// Durations from the queueing of metrics to the completion of their write.
+    DurationHistogram latency() const;
+
+    constexpr static size_t DEFAULT_CAPACITY = 4096;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Write
+    {
+        std::string       asset;
+        std::string       type;
+        std::string       value;
+        std::string       unit;
+        int               ttl;
+        Clock::time_point queued;
+    };
+
+    void run();
+
+    const size_t                           m_capacity;
+    mutable std::mutex                     m_mutex;
+    std::condition_variable                m_wakeup;
+    std::condition_variable                m_progress;
+    std::unordered_map<std::string, Write> m_pending;
+    std::deque<std::string>                m_order;
+    size_t                                 m_maxDepth = 0;
+    DurationHistogram                      m_latency;
+    bool                                   m_busy = false;
+    bool                                   m_stop = false;
+    std::atomic<uint64_t>                  m_writes{0};
+    std::atomic<uint64_t>                  m_failures{0};
+    std::atomic<uint64_t>                  m_superseded{0};
+    std::thread                            m_thread;
+};
@@ -20,67 +20,272 @@
 */
 
 #include "fty_proto_stateholders.h"
+#include <cstring>
 
-static void fty_proto_destroy_wrapper(fty_proto_t* p)
+static std::string s_string(const char* str)
 {
-    fty_proto_destroy(&p);
+    return str ? str : "";
 }
 
-void FtyAssetStateHolder::processAsset(fty_proto_t* asset)
+static uint64_t s_expiry(const FtyAlertRecord& alert)
+{
+    return alert.time + alert.ttl;
+}
+
+FtyAlertState parseAlertState(const char* state)
+{
+    if (!state) {
+        return FtyAlertState::UNKNOWN;
+    } else if (streq(state, "ACTIVE")) {
+        return FtyAlertState::ACTIVE;
+    } else if (streq(state, "RESOLVED")) {
+        return FtyAlertState::RESOLVED;
+    } else if (strncmp(state, "ACK-", 4) == 0) {
+        return FtyAlertState::ACKNOWLEDGED;
+    }
+    return FtyAlertState::UNKNOWN;
+}
+
+FtyAlertSeverity parseAlertSeverity(const char* severity)
+{
+    if (!severity) {
+        return FtyAlertSeverity::UNKNOWN;
+    } else if (streq(severity, "CRITICAL")) {
+        return FtyAlertSeverity::CRITICAL;
+    } else if (streq(severity, "WARNING")) {
+        return FtyAlertSeverity::WARNING;
+    } else if (streq(severity, "INFO")) {
+        return FtyAlertSeverity::INFO;
+    }
+    return FtyAlertSeverity::UNKNOWN;
+}
+
+const char* alertStateName(FtyAlertState state)
 {
-    FtyProto ftyProto(asset, fty_proto_destroy_wrapper);
+    static const char* names[] = {"UNKNOWN", "ACTIVE", "ACKNOWLEDGED", "RESOLVED"};
+    return names[size_t(state)];
+}
+
+const char* alertSeverityName(FtyAlertSeverity severity)
+{
+    static const char* names[] = {"UNKNOWN", "CRITICAL", "WARNING", "INFO"};
+    return names[size_t(severity)];
+}
+
+/// Deepest ancestor looked up in the parent_name.N aux fields of an asset.
+static constexpr int MAX_ASSET_DEPTH = 16;
+
+static bool s_assetRecord(fty_proto_t* asset, FtyAssetRecord& record)
+{
+    if (!fty_proto_operation(asset) || !fty_proto_name(asset)) {
+        return false;
+    }
 
-    const char* operation = fty_proto_operation(asset);
-    const char* name      = fty_proto_name(asset);
+    record.parent  = s_string(fty_proto_aux_string(asset, FTY_PROTO_ASSET_AUX_PARENT_NAME_1, nullptr));
+    record.type    = s_string(fty_proto_aux_string(asset, FTY_PROTO_ASSET_TYPE, nullptr));
+    record.subtype = s_string(fty_proto_aux_string(asset, FTY_PROTO_ASSET_SUBTYPE, nullptr));
 
-    if (operation && name) {
-        if (streq(operation, FTY_PROTO_ASSET_OP_DELETE) || streq(operation, FTY_PROTO_ASSET_OP_RETIRE)) {
-            if (callbackAssetPre(asset)) {
-                m_assets.erase(name);
-                callbackAssetPost(asset);
+    // The rest of the path up to the top-level asset, if provided
+    if (!record.parent.empty()) {
+        for (int level = 2; level <= MAX_ASSET_DEPTH; level++) {
+            const std::string key      = "parent_name." + std::to_string(level);
+            const char*       ancestor = fty_proto_aux_string(asset, key.c_str(), nullptr);
+            if (!ancestor || !*ancestor) {
+                break;
             }
-        } else {
-            if (callbackAssetPre(asset)) {
-                m_assets[name] = FtyProto(fty_proto_dup(asset), fty_proto_destroy_wrapper);
-                callbackAssetPost(asset);
+            record.ancestors.emplace_back(ancestor);
+        }
+    }
+
+    return true;
+}
+
+static void s_storeAsset(
+    FtyAssetCollection& assets, const char* name, const char* operation, const FtyAssetRecord& record)
+{
+    if (streq(operation, FTY_PROTO_ASSET_OP_DELETE) || streq(operation, FTY_PROTO_ASSET_OP_RETIRE)) {
+        assets.erase(name);
+    } else {
+        assets[name] = record;
+    }
+}
+
+static bool s_alertRecord(fty_proto_t* alert, FtyAlertRecord& record)
+{
+    if (!fty_proto_state(alert) || !fty_proto_rule(alert)) {
+        return false;
+    }
+
+    record.name     = s_string(fty_proto_name(alert));
+    record.state    = parseAlertState(fty_proto_state(alert));
+    record.severity = parseAlertSeverity(fty_proto_severity(alert));
+    record.time     = fty_proto_time(alert);
+    record.ttl      = fty_proto_ttl(alert);
+    return true;
+}
+
+static void s_storeAlert(FtyAlertCollection& alerts, const std::string& rule, const FtyAlertRecord& record)
+{
+    if (record.state == FtyAlertState::RESOLVED) {
+        alerts.erase(rule);
+    } else {
+        alerts[rule] = record;
+    }
+}
+
+void FtyAssetStateHolder::processAsset(fty_proto_t* asset)
+{
+    FtyAssetRecord record;
+
+    if (s_assetRecord(asset, record)) {
+        const char* operation = fty_proto_operation(asset);
+        const char* name      = fty_proto_name(asset);
+        record.sequence       = ++m_assetSequence;
+
+        if (callbackAssetPre(name, operation, record)) {
+            s_storeAsset(m_assets, name, operation, record);
+            if (m_loadingAssets) {
+                s_storeAsset(m_loadedAssets, name, operation, record);
             }
+
+            callbackAssetPost(name, operation, record);
         }
     }
+
+    fty_proto_destroy(&asset);
+}
+
+void FtyAssetStateHolder::beginAssetLoad()
+{
+    m_loadedAssets.clear();
+    m_loadingAssets = true;
+}
+
+void FtyAssetStateHolder::loadAsset(fty_proto_t* asset)
+{
+    FtyAssetRecord record;
+
+    if (s_assetRecord(asset, record)) {
+        record.sequence = ++m_assetSequence;
+        s_storeAsset(m_loadingAssets ? m_loadedAssets : m_assets, fty_proto_name(asset),
+            fty_proto_operation(asset), record);
+    }
+
+    fty_proto_destroy(&asset);
+}
+
+void FtyAssetStateHolder::finishAssetLoad(bool commit)
+{
+    if (commit && m_loadingAssets) {
+        m_assets.swap(m_loadedAssets);
+    }
+
+    m_loadedAssets.clear();
+    m_loadingAssets = false;
 }
 
 void FtyAlertStateHolder::processAlert(fty_proto_t* alert)
 {
-    FtyProto ftyProto(alert, fty_proto_destroy_wrapper);
+    FtyAlertRecord record;
+
+    if (s_alertRecord(alert, record)) {
+        processAlert(fty_proto_rule(alert), record);
+    }
+
+    fty_proto_destroy(&alert);
+}
+
+void FtyAlertStateHolder::beginAlertLoad()
+{
+    m_loadedAlerts.clear();
+    m_loadingAlerts = true;
+}
 
-    const char* state = fty_proto_state(alert);
-    const char* rule  = fty_proto_rule(alert);
+void FtyAlertStateHolder::loadAlert(fty_proto_t* alert)
+{
+    FtyAlertRecord record;
 
-    if (state && rule) {
-        if (streq(state, "RESOLVED")) {
-            if (callbackAlertPre(alert)) {
-                m_alerts.erase(rule);
-                callbackAlertPost(alert);
-            }
+    if (s_alertRecord(alert, record)) {
+        if (m_loadingAlerts) {
+            s_storeAlert(m_loadedAlerts, fty_proto_rule(alert), record);
         } else {
-            if (callbackAlertPre(alert)) {
-                m_alerts[rule] = FtyProto(fty_proto_dup(alert), fty_proto_destroy_wrapper);
-                callbackAlertPost(alert);
-            }
+            storeAlert(fty_proto_rule(alert), record);
+        }
+    }
+
+    fty_proto_destroy(&alert);
+}
+
+void FtyAlertStateHolder::finishAlertLoad(bool commit)
+{
+    if (commit && m_loadingAlerts) {
+        m_alerts.swap(m_loadedAlerts);
+
+        // The expiry index is rebuilt once rather than maintained during the load
+        m_alertExpiries.clear();
+        for (const auto& alert : m_alerts) {
+            m_alertExpiries.emplace(s_expiry(alert.second), alert.first);
+        }
+    }
+
+    m_loadedAlerts.clear();
+    m_loadingAlerts = false;
+}
+
+void FtyAlertStateHolder::processAlert(const std::string& rule, const FtyAlertRecord& alert)
+{
+    if (callbackAlertPre(rule, alert)) {
+        storeAlert(rule, alert);
+        if (m_loadingAlerts) {
+            s_storeAlert(m_loadedAlerts, rule, alert);
         }
+
+        callbackAlertPost(rule, alert);
+    }
+}
+
+void FtyAlertStateHolder::storeAlert(const std::string& rule, const FtyAlertRecord& alert)
+{
+    if (alert.state == FtyAlertState::RESOLVED) {
+        unindexAlert(rule);
+        m_alerts.erase(rule);
+    } else {
+        indexAlert(rule, alert);
+        m_alerts[rule] = alert;
     }
 }
 
 void FtyAlertStateHolder::purgeExpiredAlerts()
 {
-    auto it = m_alerts.begin();
-    while (it != m_alerts.end()) {
-        fty_proto_t* proto = it->second.get();
+    const uint64_t now = uint64_t(zclock_mono() / 1000);
+
+    // Only visit expired alerts, resolving them straight from their record
+    auto it = m_alertExpiries.begin();
+    while (it != m_alertExpiries.end() && it->first < now) {
+        const std::string rule = it->second;
         it++;
 
-        if ((fty_proto_time(proto) + fty_proto_ttl(proto)) < uint64_t(zclock_mono() / 1000)) {
-            fty_proto_t* dup = fty_proto_dup(proto);
-            fty_proto_set_state(dup, "RESOLVED");
-            processAlert(dup);
+        auto itAlert = m_alerts.find(rule);
+        if (itAlert != m_alerts.end()) {
+            FtyAlertRecord resolved = itAlert->second;
+            resolved.state          = FtyAlertState::RESOLVED;
+            processAlert(rule, resolved);
         }
     }
 }
+
+void FtyAlertStateHolder::indexAlert(const std::string& rule, const FtyAlertRecord& alert)
+{
+    unindexAlert(rule);
+    m_alertExpiries.emplace(s_expiry(alert), rule);
+}
+
+void FtyAlertStateHolder::unindexAlert(const std::string& rule)
+{
+    auto it = m_alerts.find(rule);
+    if (it == m_alerts.end()) {
+        return;
+    }
+
+    m_alertExpiries.erase(std::make_pair(s_expiry(it->second), rule));
+}
@@ -21,15 +21,73 @@
 
 #pragma once
 #include <fty_proto.h>
-#include <functional>
 #include <map>
-#include <memory>
+#include <set>
 #include <string>
+#include <vector>
 
-typedef std::unique_ptr<fty_proto_t, std::function<void(fty_proto_t*)>> FtyProto;
-typedef std::map<std::string, FtyProto>                                 FtyProtoCollection;
+/// Compact record of an asset, holding only what is needed to track topology.
+struct FtyAssetRecord
+{
+    /// Name of the parent asset (empty if none).
+    std::string parent;
+
+    /// Type and subtype of the asset (empty if unknown).
+    std::string type;
+    std::string subtype;
+
+    /// Names of the further ancestors of the asset, as carried by the asset
+    /// (parent_name.2 and up), closest first.
+    std::vector<std::string> ancestors;
+
+    /// Order in which the record was stored (later records have higher numbers).
+    uint64_t sequence = 0;
+};
+
+/// State of an alert, parsed once from fty_proto_state().
+enum class FtyAlertState : uint8_t
+{
+    UNKNOWN,
+    ACTIVE,
+    ACKNOWLEDGED, ///< any of the ACK-* states
+    RESOLVED,
+    COUNT
+};
+
+/// Severity of an alert, parsed once from fty_proto_severity().
+enum class FtyAlertSeverity : uint8_t
+{
+    UNKNOWN,
+    CRITICAL,
+    WARNING,
+    INFO,
+    COUNT
+};
+
+FtyAlertState    parseAlertState(const char* state);
+FtyAlertSeverity parseAlertSeverity(const char* severity);
+const char*      alertStateName(FtyAlertState state);
+const char*      alertSeverityName(FtyAlertSeverity severity);
+
+/// Compact record of an alert, holding only what is needed to tally alerts.
+struct FtyAlertRecord
+{
+    /// Name of the asset the alert is attached to.
+    std::string      name;
+    FtyAlertState    state    = FtyAlertState::UNKNOWN;
+    FtyAlertSeverity severity = FtyAlertSeverity::UNKNOWN;
+    uint64_t         time     = 0;
+    uint64_t         ttl      = 0;
+};
+
+typedef std::map<std::string, FtyAssetRecord>      FtyAssetCollection;
+typedef std::map<std::string, FtyAlertRecord>      FtyAlertCollection;
+typedef std::set<std::pair<uint64_t, std::string>> FtyAlertExpiries;
 
 /// Helper class for tracking fty_proto_t assets.
+///
+/// Only the fields of interest are extracted from the fty_proto_t objects when
+/// they are processed, the objects themselves are not kept around.
 class FtyAssetStateHolder
 {
 public:
@@ -38,31 +96,60 @@ public:
 protected:
     /// Process the asset and call the callbacks methods.
     ///
+    /// While a bulk load is in progress, the change is mirrored into the
+    /// collection being loaded so that it is not lost when it is committed.
+    ///
     /// This method takes ownership of the fty_proto_t object.
     void processAsset(fty_proto_t* asset);
 
-    /// Callback called before registering (or deleting) an asset. The method must
-    /// NOT take ownership of the object.
-    /// @param asset fty_proto_t asset object
+    /// Start a bulk load into a shadow collection, leaving m_assets untouched.
+    void beginAssetLoad();
+
+    /// Register (or delete) the asset in the collection being loaded without
+    /// calling the callbacks methods (in m_assets if no load is in progress).
+    ///
+    /// This method takes ownership of the fty_proto_t object.
+    void loadAsset(fty_proto_t* asset);
+
+    /// End the bulk load, replacing m_assets with the loaded collection if
+    /// commit is true or discarding it otherwise. No callbacks are called.
+    void finishAssetLoad(bool commit);
+
+    /// Callback called before registering (or deleting) an asset.
+    /// @param name name of the asset
+    /// @param operation fty_proto_t asset operation
+    /// @param asset record of the asset
     /// @return true if the asset shall be registered/deleted, false if it shall
     /// be ignored.
-    virtual bool callbackAssetPre(fty_proto_t* /*asset*/)
+    virtual bool callbackAssetPre(
+        const std::string& /*name*/, const char* /*operation*/, const FtyAssetRecord& /*asset*/)
     {
         return true;
     }
 
-    /// Callback called after registering (or deleting) an asset. The method must
-    /// NOT take ownership of the object.
-    /// @param asset fty_proto_t asset object
-    virtual void callbackAssetPost(fty_proto_t* /*asset*/)
+    /// Callback called after registering (or deleting) an asset.
+    /// @param name name of the asset
+    /// @param operation fty_proto_t asset operation
+    /// @param asset record of the asset
+    virtual void callbackAssetPost(
+        const std::string& /*name*/, const char* /*operation*/, const FtyAssetRecord& /*asset*/)
     {
     }
 
     /// Collection of known assets.
-    FtyProtoCollection m_assets;
+    FtyAssetCollection m_assets;
+
+private:
+    /// Collection being bulk loaded.
+    FtyAssetCollection m_loadedAssets;
+    bool               m_loadingAssets = false;
+    uint64_t           m_assetSequence = 0;
 };
 
 /// Helper class for tracking fty_proto_t alerts.
+///
+/// Only the fields of interest are extracted from the fty_proto_t objects when
+/// they are processed, the objects themselves are not kept around.
 class FtyAlertStateHolder
 {
 public:
@@ -71,29 +158,59 @@ public:
 protected:
     /// Process the alert and call the callbacks methods.
     ///
+    /// While a bulk load is in progress, the change is mirrored into the
+    /// collection being loaded so that it is not lost when it is committed.
+    ///
     /// This method takes ownership of the fty_proto_t object.
     void processAlert(fty_proto_t* alert);
 
+    /// Start a bulk load into a shadow collection, leaving m_alerts untouched.
+    void beginAlertLoad();
+
+    /// Register (or delete) the alert in the collection being loaded without
+    /// calling the callbacks methods (in m_alerts if no load is in progress).
+    ///
+    /// This method takes ownership of the fty_proto_t object.
+    void loadAlert(fty_proto_t* alert);
+
+    /// End the bulk load, replacing m_alerts with the loaded collection (and
+    /// rebuilding the expiry index) if commit is true or discarding it otherwise.
+    /// No callbacks are called.
+    void finishAlertLoad(bool commit);
+
     /// Call resolve callbacks on expired alerts (i.e. delete them).
     void purgeExpiredAlerts();
 
-    /// Callback called before registering (or deleting) an alert. The method must
-    /// NOT take ownership of the object.
-    /// @param asset fty_proto_t alert object
+    /// Callback called before registering (or deleting) an alert.
+    /// @param rule rule of the alert
+    /// @param alert record of the alert
     /// @return true if the alert shall be registered/deleted, false if it shall
     /// be ignored.
-    virtual bool callbackAlertPre(fty_proto_t* /*alert*/)
+    virtual bool callbackAlertPre(const std::string& /*rule*/, const FtyAlertRecord& /*alert*/)
     {
         return true;
     }
 
-    /// Callback called after registering (or deleting) an alert. The method must
-    /// NOT take ownership of the object.
-    /// @param asset fty_proto_t alert object
-    virtual void callbackAlertPost(fty_proto_t* /*alert*/)
+    /// Callback called after registering (or deleting) an alert.
+    /// @param rule rule of the alert
+    /// @param alert record of the alert
+    virtual void callbackAlertPost(const std::string& /*rule*/, const FtyAlertRecord& /*alert*/)
     {
     }
 
     /// Collection of known alerts.
-    FtyProtoCollection m_alerts;
+    FtyAlertCollection m_alerts;
+
+    /// Rules of known alerts ordered by expiration time (time + ttl).
+    FtyAlertExpiries m_alertExpiries;
+
+private:
+    /// Collection being bulk loaded (not indexed until committed).
+    FtyAlertCollection m_loadedAlerts;
+    bool               m_loadingAlerts = false;
+
+    void processAlert(const std::string& rule, const FtyAlertRecord& alert);
+    void storeAlert(const std::string& rule, const FtyAlertRecord& alert);
+    void indexAlert(const std::string& rule, const FtyAlertRecord& alert);
+    void unindexAlert(const std::string& rule);
 };
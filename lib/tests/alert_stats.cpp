@@ -190,6 +190,46 @@ TEST_CASE("alert stats server test")
                 fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::WARNING_METRIC, "datacenter-3", "2", ""),
                 fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::CRITICAL_METRIC, "datacenter-3", "0", "")},
             TestCase::Action::CHECK_METRICS},
+        {"Delete rackcontroller-2 (with known alerts)",
+            {
+                buildAssetMsg("rackcontroller-2", FTY_PROTO_ASSET_OP_DELETE,
+                    {{"status", "active"}, {FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "datacenter-3"}}),
+            },
+            {},
+            {fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::WARNING_METRIC, "datacenter-3", "1", ""),
+                fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::CRITICAL_METRIC, "datacenter-3", "0", "")},
+            TestCase::Action::CHECK_METRICS},
+        {"Create rack-9 below unknown containers",
+            {
+                buildAssetMsg("rack-9", FTY_PROTO_ASSET_OP_CREATE,
+                    {{"status", "active"}, {FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "row-9"}, {"parent_name.2", "room-9"},
+                        {"parent_name.3", "datacenter-9"}}),
+            },
+            {}, {}, TestCase::Action::PURGE_METRICS},
+        {"Publish CRITICAL alert5@rack-9", {},
+            {fty_proto_encode_alert(nullptr, uint64_t(zclock_time() / 1000), 60, "alert5@rack-9", "rack-9", "ACTIVE",
+                "CRITICAL", "", nullptr)},
+            {fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::CRITICAL_METRIC, "rack-9", "1", ""),
+                fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::CRITICAL_METRIC, "row-9", "1", ""),
+                fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::CRITICAL_METRIC, "room-9", "1", ""),
+                fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::CRITICAL_METRIC, "datacenter-9", "1", "")},
+            TestCase::Action::CHECK_METRICS},
+        {"Create room-9 after its descendants",
+            {
+                buildAssetMsg("room-9", FTY_PROTO_ASSET_OP_CREATE,
+                    {{"status", "active"}, {FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "datacenter-9"}}),
+            },
+            {}, {}, TestCase::Action::CHECK_NO_METRICS},
+        {"Publish WARNING alert6@row-9", {},
+            {fty_proto_encode_alert(nullptr, uint64_t(zclock_time() / 1000), 60, "alert6@row-9", "row-9", "ACTIVE",
+                "WARNING", "", nullptr)},
+            {fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::WARNING_METRIC, "row-9", "1", ""),
+                fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::CRITICAL_METRIC, "row-9", "1", ""),
+                fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::WARNING_METRIC, "room-9", "1", ""),
+                fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::CRITICAL_METRIC, "room-9", "1", ""),
+                fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::WARNING_METRIC, "datacenter-9", "1", ""),
+                fty_proto_encode_metric(nullptr, 0, 0, AlertStatsActor::CRITICAL_METRIC, "datacenter-9", "1", "")},
+            TestCase::Action::CHECK_METRICS},
     };
 
     const char* endpoint = "inproc://fty-alert-stats-server-test";
@@ -264,6 +304,41 @@ TEST_CASE("alert stats server test")
         }
     }
 
+    //  Query runtime counters
+    {
+        mlm_client_t* stats_client = mlm_client_new();
+        REQUIRE(stats_client);
+        REQUIRE(mlm_client_connect(stats_client, endpoint, 1000, "stats_client") == 0);
+
+        zmsg_t* request = zmsg_new();
+        REQUIRE(mlm_client_sendto(stats_client, "fty-alert-stats", "STATS", nullptr, 1000, &request) == 0);
+
+        zmsg_t* reply = mlm_client_recv(stats_client);
+        REQUIRE(reply);
+        CHECK(streq(mlm_client_subject(stats_client), "STATS"));
+
+        std::map<std::string, std::string> stats;
+        while (zmsg_size(reply) >= 2) {
+            char* name  = zmsg_popstr(reply);
+            char* value = zmsg_popstr(reply);
+            stats[name] = value;
+            zstr_free(&name);
+            zstr_free(&value);
+        }
+        zmsg_destroy(&reply);
+
+        CHECK(stats["messages.stream.assets"] == "12");
+        CHECK(stats["messages.stream.alerts"] == "11");
+        CHECK(stats["messages.decode_failures"] == "0");
+        CHECK(stats["messages.stream.batches"] != "0");
+        CHECK(stats["messages.mailbox.stats"] == "1");
+        CHECK(stats["size.assets"] == "8");
+        CHECK(stats["shm.writes"] != "0");
+        CHECK(stats.count("tick.duration"));
+
+        mlm_client_destroy(&stats_client);
+    }
+
     mlm_client_destroy(&alerts_producer);
     mlm_client_destroy(&assets_producer);
     zactor_destroy(&alert_stats_server);
@@ -271,3 +346,216 @@ TEST_CASE("alert stats server test")
 
     fty_shm_delete_test_dir();
 }
+
+TEST_CASE("alert stats deleted assets")
+{
+    const char* endpoint = "inproc://fty-alert-stats-delete-test";
+
+    fty_shm_set_test_dir(".");
+
+    zactor_t* server = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    REQUIRE(server);
+    zstr_sendx(server, "BIND", endpoint, NULL);
+
+    AlertStatsActorParams params;
+    params.endpoint      = endpoint;
+    zactor_t* alertStats = zactor_new(fty_alert_stats_server, reinterpret_cast<void*>(&params));
+    REQUIRE(alertStats);
+
+    mlm_client_t* producer = mlm_client_new();
+    REQUIRE(mlm_client_connect(producer, endpoint, 1000, "producer") == 0);
+    REQUIRE(mlm_client_set_producer(producer, FTY_PROTO_STREAM_ASSETS) == 0);
+    mlm_client_t* alertsProducer = mlm_client_new();
+    REQUIRE(mlm_client_connect(alertsProducer, endpoint, 1000, "alerts_producer") == 0);
+    REQUIRE(mlm_client_set_producer(alertsProducer, FTY_PROTO_STREAM_ALERTS) == 0);
+    mlm_client_t* client = mlm_client_new();
+    REQUIRE(mlm_client_connect(client, endpoint, 1000, "republish_client") == 0);
+
+    auto send = [](mlm_client_t* client, zmsg_t* msg) {
+        REQUIRE(mlm_client_send(client, "message", &msg) == 0);
+    };
+    auto metric = [](const char* asset) {
+        std::string value;
+        fty::shm::read_metric_value(asset, AlertStatsActor::WARNING_METRIC, value);
+        return value;
+    };
+    auto waitMetric = [&metric](const char* asset, const std::string& expected) {
+        for (int i = 0; i < 50 && metric(asset) != expected; i++) {
+            zclock_sleep(100);
+        }
+        return metric(asset);
+    };
+    auto alert = [&send, alertsProducer](const char* asset) {
+        const std::string rule = std::string("alert@") + asset;
+        const uint64_t    now  = uint64_t(zclock_time() / 1000);
+        send(alertsProducer,
+            fty_proto_encode_alert(nullptr, now, 600, rule.c_str(), asset, "ACTIVE", "WARNING", "", nullptr));
+    };
+
+    // Start from an empty shm and have the agent write out everything it publishes
+    auto republish = [client]() {
+        fty_shm_delete_test_dir();
+        fty_shm_set_test_dir(".");
+
+        zmsg_t* request = zmsg_new();
+        REQUIRE(mlm_client_sendto(client, "fty-alert-stats", "REPUBLISH", nullptr, 1000, &request) == 0);
+        zmsg_t* reply = mlm_client_recv(client);
+        REQUIRE(reply);
+        zmsg_destroy(&reply);
+    };
+
+    // datacenter-1 > rack-1, and datacenter-1 > row-1 > rack-2 > device-1, a WARNING on each but the row
+    send(producer, buildAssetMsg("datacenter-1", FTY_PROTO_ASSET_OP_CREATE, {{"status", "active"}}));
+    send(producer,
+        buildAssetMsg("rack-1", FTY_PROTO_ASSET_OP_CREATE, {{FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "datacenter-1"}}));
+    send(producer,
+        buildAssetMsg("row-1", FTY_PROTO_ASSET_OP_CREATE, {{FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "datacenter-1"}}));
+    send(producer, buildAssetMsg("rack-2", FTY_PROTO_ASSET_OP_CREATE, {{FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "row-1"}}));
+    send(producer,
+        buildAssetMsg("device-1", FTY_PROTO_ASSET_OP_CREATE, {{FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "rack-2"}}));
+    for (const char* asset : {"rack-1", "rack-2", "device-1"}) {
+        alert(asset);
+    }
+
+    CHECK(waitMetric("datacenter-1", "3") == "3");
+    CHECK(metric("row-1") == "2");
+    CHECK(metric("rack-1") == "1");
+
+    // Once deleted, the metrics of the rack are no longer republished
+    send(producer, buildAssetMsg("rack-1", FTY_PROTO_ASSET_OP_DELETE));
+    CHECK(waitMetric("datacenter-1", "2") == "2");
+
+    republish();
+    CHECK(metric("rack-1").empty());
+    CHECK(metric("rack-2") == "2");
+    CHECK(metric("row-1") == "2");
+    CHECK(metric("datacenter-1") == "2");
+
+    // Same for a container that still has children with alerts, which no longer reach its former ancestors
+    send(producer, buildAssetMsg("rack-2", FTY_PROTO_ASSET_OP_DELETE));
+    CHECK(waitMetric("datacenter-1", "0") == "0");
+    CHECK(metric("row-1") == "0");
+
+    republish();
+    CHECK(metric("rack-2").empty());
+    CHECK(metric("row-1") == "0");
+    CHECK(metric("datacenter-1") == "0");
+
+    // A child still naming the deleted rack in its path doesn't bring it back (rack-3 tells when it's processed)
+    send(producer,
+        buildAssetMsg("device-1", FTY_PROTO_ASSET_OP_UPDATE,
+            {{FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "rack-2"}, {"parent_name.2", "row-1"},
+                {"parent_name.3", "datacenter-1"}}));
+    send(producer,
+        buildAssetMsg("rack-3", FTY_PROTO_ASSET_OP_CREATE, {{FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "datacenter-1"}}));
+    CHECK(waitMetric("rack-3", "0") == "0");
+    CHECK(metric("row-1") == "0");
+    CHECK(metric("datacenter-1") == "0");
+
+    republish();
+    CHECK(metric("rack-2").empty());
+    CHECK(metric("rack-3") == "0");
+    CHECK(metric("row-1") == "0");
+    CHECK(metric("datacenter-1") == "0");
+
+    mlm_client_destroy(&client);
+    mlm_client_destroy(&alertsProducer);
+    mlm_client_destroy(&producer);
+    zactor_destroy(&alertStats);
+    zactor_destroy(&server);
+
+    fty_shm_delete_test_dir();
+}
+
+TEST_CASE("alert stats conflicting paths")
+{
+    const char* endpoint = "inproc://fty-alert-stats-paths-test";
+
+    fty_shm_set_test_dir(".");
+
+    zactor_t* server = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    REQUIRE(server);
+    zstr_sendx(server, "BIND", endpoint, NULL);
+
+    AlertStatsActorParams params;
+    params.endpoint      = endpoint;
+    zactor_t* alertStats = zactor_new(fty_alert_stats_server, reinterpret_cast<void*>(&params));
+    REQUIRE(alertStats);
+
+    mlm_client_t* producer = mlm_client_new();
+    REQUIRE(mlm_client_connect(producer, endpoint, 1000, "producer") == 0);
+    REQUIRE(mlm_client_set_producer(producer, FTY_PROTO_STREAM_ASSETS) == 0);
+    mlm_client_t* alertsProducer = mlm_client_new();
+    REQUIRE(mlm_client_connect(alertsProducer, endpoint, 1000, "alerts_producer") == 0);
+    REQUIRE(mlm_client_set_producer(alertsProducer, FTY_PROTO_STREAM_ALERTS) == 0);
+    mlm_client_t* client = mlm_client_new();
+    REQUIRE(mlm_client_connect(client, endpoint, 1000, "republish_client") == 0);
+
+    auto send = [](mlm_client_t* client, zmsg_t* msg) {
+        REQUIRE(mlm_client_send(client, "message", &msg) == 0);
+    };
+    auto metric = [](const char* asset) {
+        std::string value;
+        fty::shm::read_metric_value(asset, AlertStatsActor::WARNING_METRIC, value);
+        return value;
+    };
+    auto waitMetric = [&metric](const char* asset, const std::string& expected) {
+        for (int i = 0; i < 50 && metric(asset) != expected; i++) {
+            zclock_sleep(100);
+        }
+        return metric(asset);
+    };
+
+    /**
+     * Both devices sit in rack-1, which we have no record of, but give
+     * conflicting paths for it. The latest one (device-2) puts it in row-2,
+     * although going through the records by name meets device-1 first.
+     */
+    send(producer, buildAssetMsg("datacenter-1", FTY_PROTO_ASSET_OP_CREATE, {{"status", "active"}}));
+    for (const char* row : {"row-1", "row-2"}) {
+        send(producer,
+            buildAssetMsg(row, FTY_PROTO_ASSET_OP_CREATE, {{FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "datacenter-1"}}));
+    }
+    send(producer,
+        buildAssetMsg("device-1", FTY_PROTO_ASSET_OP_CREATE,
+            {{FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "rack-1"}, {"parent_name.2", "row-1"},
+                {"parent_name.3", "datacenter-1"}}));
+    send(producer,
+        buildAssetMsg("device-2", FTY_PROTO_ASSET_OP_CREATE,
+            {{FTY_PROTO_ASSET_AUX_PARENT_NAME_1, "rack-1"}, {"parent_name.2", "row-2"},
+                {"parent_name.3", "datacenter-1"}}));
+    for (const char* device : {"device-1", "device-2"}) {
+        const std::string rule = std::string("alert@") + device;
+        const uint64_t    now  = uint64_t(zclock_time() / 1000);
+        send(alertsProducer,
+            fty_proto_encode_alert(nullptr, now, 600, rule.c_str(), device, "ACTIVE", "WARNING", "", nullptr));
+    }
+
+    CHECK(waitMetric("datacenter-1", "2") == "2");
+    CHECK(waitMetric("row-2", "2") == "2");
+    CHECK(metric("row-1") == "0");
+    CHECK(metric("rack-1") == "2");
+
+    // A full recompute comes up with the same counts, from an empty shm
+    fty_shm_delete_test_dir();
+    fty_shm_set_test_dir(".");
+
+    zmsg_t* request = zmsg_new();
+    REQUIRE(mlm_client_sendto(client, "fty-alert-stats", "REPUBLISH", nullptr, 1000, &request) == 0);
+    zmsg_t* reply = mlm_client_recv(client);
+    REQUIRE(reply);
+    zmsg_destroy(&reply);
+
+    CHECK(metric("datacenter-1") == "2");
+    CHECK(metric("row-2") == "2");
+    CHECK(metric("row-1") == "0");
+    CHECK(metric("rack-1") == "2");
+
+    mlm_client_destroy(&client);
+    mlm_client_destroy(&alertsProducer);
+    mlm_client_destroy(&producer);
+    zactor_destroy(&alertStats);
+    zactor_destroy(&server);
+
+    fty_shm_delete_test_dir();
+}
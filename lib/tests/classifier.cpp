@@ -0,0 +1,28 @@
+#include "src/fty_alert_stats_classifier.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("publishable asset classifier")
+{
+    AssetClassifier classifier(AssetClassifier::defaultPrefixes(), {"zone", "group"});
+
+    CHECK(classifier.classify("datacenter-3"));
+    CHECK(classifier.classify("rack-6"));
+    CHECK(!classifier.classify("rackcontroller-0"));
+    CHECK(!classifier.classify("zone-1"));
+
+    CHECK(classifier.classify("zone-1", "zone", ""));
+    CHECK(classifier.classify("group-7", "group", "n_a"));
+    CHECK(classifier.classify("custom-2", "device", "zone"));
+    CHECK(classifier.classify("rack-6", "device", "ups"));
+    CHECK(!classifier.classify("ups-1", "device", "ups"));
+
+    AssetClassifier none;
+    CHECK(!none.classify("datacenter-3", "datacenter", ""));
+}
+
+TEST_CASE("classifier list parsing")
+{
+    CHECK(AssetClassifier::parseList("") == std::vector<std::string>{});
+    CHECK(AssetClassifier::parseList("rack") == std::vector<std::string>{"rack"});
+    CHECK(AssetClassifier::parseList(" room-, row- ,,rack-") == std::vector<std::string>{"room-", "row-", "rack-"});
+}
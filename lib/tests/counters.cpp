@@ -0,0 +1,19 @@
+#include "src/fty_alert_stats_counters.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("duration histogram")
+{
+    DurationHistogram histogram;
+    CHECK(histogram.str() == "count=0 sum=0 max=0 buckets=");
+
+    histogram.record(0);
+    histogram.record(1);
+    histogram.record(2);
+    histogram.record(3);
+    histogram.record(4);
+    histogram.record(1000);
+    histogram.record(-5);
+
+    CHECK(histogram.count() == 7);
+    CHECK(histogram.str() == "count=7 sum=1010 max=1000 buckets=1:3,2:1,4:2,1024:1");
+}
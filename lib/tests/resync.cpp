@@ -0,0 +1,473 @@
+#include "src/fty_alert_stats_actor.h"
+#include "src/fty_alert_stats_server.h"
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <czmq.h>
+#include <fty_proto.h>
+#include <fty_shm.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+/// Stand-in for asset-agent and fty-alert-list, answering resync queries.
+///
+/// While hold is set, ASSET_DETAIL queries are kept unanswered until the mock
+/// actor receives RELEASE on its pipe.
+struct MockAgents
+{
+    std::string                                     endpoint;
+    std::map<std::string, std::string>              parents; // asset -> parent
+    std::map<std::string, std::vector<std::string>> paths;   // asset -> parent_name.2 and above
+    std::map<std::string, std::string>              alerts;  // rule -> asset
+    std::atomic<int>                                detailQueries{0};
+    std::atomic<bool>                               hold{false};
+};
+
+struct HeldQuery
+{
+    std::string sender;
+    std::string subject;
+    zmsg_t*     msg;
+};
+
+zmsg_t* buildAsset(const MockAgents& mock, const std::string& name)
+{
+    zhash_t* aux = zhash_new();
+    zhash_t* ext = zhash_new();
+
+    const std::string& parent = mock.parents.at(name);
+    if (!parent.empty()) {
+        zhash_insert(aux, FTY_PROTO_ASSET_AUX_PARENT_NAME_1, const_cast<char*>(parent.c_str()));
+    }
+
+    auto path = mock.paths.find(name);
+    if (path != mock.paths.end()) {
+        for (size_t level = 0; level < path->second.size(); level++) {
+            const std::string key = "parent_name." + std::to_string(level + 2);
+            zhash_insert(aux, key.c_str(), const_cast<char*>(path->second[level].c_str()));
+        }
+    }
+
+    zmsg_t* msg = fty_proto_encode_asset(aux, name.c_str(), FTY_PROTO_ASSET_OP_UPDATE, ext);
+
+    zhash_destroy(&aux);
+    zhash_destroy(&ext);
+    return msg;
+}
+
+void answerAssetAgent(
+    MockAgents& mock, mlm_client_t* client, const std::string& sender, const std::string& subject, zmsg_t* msg)
+{
+    zmsg_t* reply = nullptr;
+
+    if (subject == "ASSETS_IN_CONTAINER") {
+        reply = zmsg_new();
+        zmsg_addstr(reply, "OK");
+        for (const auto& i : mock.parents) {
+            zmsg_addstr(reply, i.first.c_str());
+        }
+    } else if (subject == "ASSET_DETAIL") {
+        char* get  = zmsg_popstr(msg);
+        char* uuid = zmsg_popstr(msg);
+        mock.detailQueries++;
+
+        if (streq(uuid, "_ASSET_DETAIL_BATCH_RESULT")) {
+            reply = zmsg_new();
+            zmsg_addstr(reply, uuid);
+            while (zmsg_size(msg)) {
+                char*   name  = zmsg_popstr(msg);
+                zmsg_t* asset = buildAsset(mock, name);
+                zmsg_addmsg(reply, &asset);
+                zstr_free(&name);
+            }
+        } else {
+            char* name = zmsg_popstr(msg);
+            reply      = buildAsset(mock, name);
+            zmsg_pushstr(reply, uuid);
+            zstr_free(&name);
+        }
+
+        zstr_free(&get);
+        zstr_free(&uuid);
+    }
+
+    if (reply) {
+        mlm_client_sendto(client, sender.c_str(), subject.c_str(), nullptr, 1000, &reply);
+    }
+    zmsg_destroy(&msg);
+}
+
+void handleAssetAgent(MockAgents& mock, mlm_client_t* client, std::vector<HeldQuery>& held)
+{
+    zmsg_t*     msg     = mlm_client_recv(client);
+    std::string sender  = mlm_client_sender(client);
+    std::string subject = mlm_client_subject(client);
+
+    if (mock.hold && subject == "ASSET_DETAIL") {
+        held.push_back({sender, subject, msg});
+    } else {
+        answerAssetAgent(mock, client, sender, subject, msg);
+    }
+}
+
+void handleAlertList(MockAgents& mock, mlm_client_t* client)
+{
+    zmsg_t*     msg     = mlm_client_recv(client);
+    std::string sender  = mlm_client_sender(client);
+    std::string subject = mlm_client_subject(client);
+
+    zmsg_t* reply = zmsg_new();
+    zmsg_addstr(reply, "LIST");
+    zmsg_addstr(reply, "ALL");
+    for (const auto& i : mock.alerts) {
+        const char* severity = i.second.find("room-") == 0 ? "CRITICAL" : "WARNING";
+        zmsg_t*     alert    = fty_proto_encode_alert(nullptr, uint64_t(zclock_time() / 1000), 600, i.first.c_str(),
+            i.second.c_str(), "ACTIVE", severity, "", nullptr);
+        zmsg_addmsg(reply, &alert);
+    }
+
+    mlm_client_sendto(client, sender.c_str(), subject.c_str(), nullptr, 1000, &reply);
+    zmsg_destroy(&msg);
+}
+
+void mockAgents(zsock_t* pipe, void* args)
+{
+    MockAgents& mock = *reinterpret_cast<MockAgents*>(args);
+
+    mlm_client_t* assetAgent = mlm_client_new();
+    mlm_client_connect(assetAgent, mock.endpoint.c_str(), 1000, "asset-agent");
+    mlm_client_t* alertList = mlm_client_new();
+    mlm_client_connect(alertList, mock.endpoint.c_str(), 1000, "fty-alert-list");
+
+    zpoller_t* poller = zpoller_new(pipe, mlm_client_msgpipe(assetAgent), mlm_client_msgpipe(alertList), nullptr);
+    zsock_signal(pipe, 0);
+
+    std::vector<HeldQuery> held;
+    while (!zsys_interrupted) {
+        void* which = zpoller_wait(poller, -1);
+
+        if (which == mlm_client_msgpipe(assetAgent)) {
+            handleAssetAgent(mock, assetAgent, held);
+        } else if (which == mlm_client_msgpipe(alertList)) {
+            handleAlertList(mock, alertList);
+        } else if (which == pipe) {
+            char* command = zstr_recv(pipe);
+            bool  release = command && streq(command, "RELEASE");
+            zstr_free(&command);
+            if (!release) {
+                // $TERM
+                break;
+            }
+
+            mock.hold = false;
+            for (HeldQuery& query : held) {
+                answerAssetAgent(mock, assetAgent, query.sender, query.subject, query.msg);
+            }
+            held.clear();
+        } else {
+            // Interrupted
+            break;
+        }
+    }
+
+    for (HeldQuery& query : held) {
+        zmsg_destroy(&query.msg);
+    }
+
+    zpoller_destroy(&poller);
+    mlm_client_destroy(&alertList);
+    mlm_client_destroy(&assetAgent);
+}
+
+std::string readMetric(const char* asset, const char* type)
+{
+    std::string  value;
+    fty_proto_t* metric = nullptr;
+
+    if (fty::shm::read_metric(asset, type, &metric) == 0) {
+        value = fty_proto_value(metric);
+        fty_proto_destroy(&metric);
+    }
+    return value;
+}
+
+/// Wait for a metric to take the expected value, return the last value read.
+std::string waitMetric(const char* asset, const char* type, const std::string& expected)
+{
+    std::string value = readMetric(asset, type);
+    for (int i = 0; i < 100 && value != expected; i++) {
+        zclock_sleep(100);
+        value = readMetric(asset, type);
+    }
+    return value;
+}
+
+/// datacenter-1 > 4 rooms > 4 rows each > 4 racks each, a WARNING per rack and a CRITICAL per room
+void populate(MockAgents& mock)
+{
+    mock.parents["datacenter-1"] = "";
+    for (int room = 0; room < 4; room++) {
+        std::string roomName             = "room-" + std::to_string(room);
+        mock.parents[roomName]           = "datacenter-1";
+        mock.alerts["alert@" + roomName] = roomName;
+
+        for (int row = 0; row < 4; row++) {
+            std::string rowName   = "row-" + std::to_string(room) + "-" + std::to_string(row);
+            mock.parents[rowName] = roomName;
+
+            for (int rack = 0; rack < 4; rack++) {
+                std::string rackName =
+                    "rack-" + std::to_string(room) + "-" + std::to_string(row) + "-" + std::to_string(rack);
+                mock.parents[rackName]           = rowName;
+                mock.alerts["alert@" + rackName] = rackName;
+            }
+        }
+    }
+}
+
+/// Resynchronize an agent against the mock, return the number of ASSET_DETAIL queries it performed.
+int runResync(int64_t assetQueryBatch)
+{
+    const char* endpoint = "inproc://fty-alert-stats-resync-test";
+
+    fty_shm_set_test_dir(".");
+
+    zactor_t* server = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    REQUIRE(server);
+    zstr_sendx(server, "BIND", endpoint, NULL);
+
+    MockAgents mock;
+    mock.endpoint = endpoint;
+    populate(mock);
+
+    zactor_t* agents = zactor_new(mockAgents, &mock);
+    REQUIRE(agents);
+
+    AlertStatsActorParams params;
+    params.endpoint        = endpoint;
+    params.metricTTL       = 180;
+    params.pollerTimeout   = 720 * 1000;
+    params.assetQueryBatch = assetQueryBatch;
+    zactor_t* alertStats   = zactor_new(fty_alert_stats_server, reinterpret_cast<void*>(&params));
+    REQUIRE(alertStats);
+
+    zstr_send(alertStats, "RESYNC");
+
+    // Metrics are published once the resync is complete
+    std::string warning;
+    for (int i = 0; i < 100 && warning.empty(); i++) {
+        zclock_sleep(100);
+        warning = readMetric("datacenter-1", AlertStatsActor::WARNING_METRIC);
+    }
+
+    CHECK(warning == "64");
+    CHECK(readMetric("datacenter-1", AlertStatsActor::CRITICAL_METRIC) == "4");
+    CHECK(readMetric("room-2", AlertStatsActor::WARNING_METRIC) == "16");
+    CHECK(readMetric("room-2", AlertStatsActor::CRITICAL_METRIC) == "1");
+    CHECK(readMetric("row-2-3", AlertStatsActor::WARNING_METRIC) == "4");
+    CHECK(readMetric("rack-2-3-1", AlertStatsActor::WARNING_METRIC) == "1");
+
+    zactor_destroy(&alertStats);
+    zactor_destroy(&agents);
+    zactor_destroy(&server);
+
+    fty_shm_delete_test_dir();
+
+    return mock.detailQueries;
+}
+
+} // namespace
+
+TEST_CASE("alert stats resync test")
+{
+    // 1 datacenter + 4 rooms + 16 rows + 64 racks
+    SECTION("one asset per query")
+    {
+        CHECK(runResync(1) == 85);
+    }
+    SECTION("batched asset queries")
+    {
+        CHECK(runResync(16) == 6);
+    }
+}
+
+TEST_CASE("alert stats resync keeps publishing")
+{
+    const char* endpoint = "inproc://fty-alert-stats-resync-publish-test";
+
+    fty_shm_set_test_dir(".");
+
+    zactor_t* server = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    REQUIRE(server);
+    zstr_sendx(server, "BIND", endpoint, NULL);
+
+    MockAgents mock;
+    mock.endpoint = endpoint;
+    populate(mock);
+
+    zactor_t* agents = zactor_new(mockAgents, &mock);
+    REQUIRE(agents);
+
+    AlertStatsActorParams params;
+    params.endpoint      = endpoint;
+    params.metricTTL     = 180;
+    params.pollerTimeout = 720 * 1000;
+    zactor_t* alertStats = zactor_new(fty_alert_stats_server, reinterpret_cast<void*>(&params));
+    REQUIRE(alertStats);
+
+    mlm_client_t* alertsProducer = mlm_client_new();
+    REQUIRE(mlm_client_connect(alertsProducer, endpoint, 1000, "alerts_producer") == 0);
+    REQUIRE(mlm_client_set_producer(alertsProducer, FTY_PROTO_STREAM_ALERTS) == 0);
+
+    zstr_send(alertStats, "RESYNC");
+    CHECK(waitMetric("datacenter-1", AlertStatsActor::WARNING_METRIC, "64") == "64");
+
+    // Resolve an alert behind the agent's back, then resync with asset details held back
+    mock.alerts.erase("alert@rack-0-0-0");
+    mock.hold = true;
+    zstr_send(alertStats, "RESYNC");
+
+    // Alerts received while resynchronizing are published right away
+    zmsg_t* alert = fty_proto_encode_alert(nullptr, uint64_t(zclock_time() / 1000), 600, "extra@rack-1-0-0",
+        "rack-1-0-0", "ACTIVE", "WARNING", "", nullptr);
+    REQUIRE(mlm_client_send(alertsProducer, "alert", &alert) == 0);
+
+    CHECK(waitMetric("rack-1-0-0", AlertStatsActor::WARNING_METRIC, "2") == "2");
+    CHECK(waitMetric("datacenter-1", AlertStatsActor::WARNING_METRIC, "65") == "65");
+    CHECK(readMetric("rack-0-0-0", AlertStatsActor::WARNING_METRIC) == "1");
+
+    // Once complete, the resynchronized data is swapped in (keeping the alert received meanwhile)
+    zstr_send(agents, "RELEASE");
+
+    CHECK(waitMetric("rack-0-0-0", AlertStatsActor::WARNING_METRIC, "0") == "0");
+    CHECK(waitMetric("datacenter-1", AlertStatsActor::WARNING_METRIC, "64") == "64");
+    CHECK(readMetric("rack-1-0-0", AlertStatsActor::WARNING_METRIC) == "2");
+
+    mlm_client_destroy(&alertsProducer);
+    zactor_destroy(&alertStats);
+    zactor_destroy(&agents);
+    zactor_destroy(&server);
+
+    fty_shm_delete_test_dir();
+}
+
+TEST_CASE("alert stats health metrics")
+{
+    const char* endpoint = "inproc://fty-alert-stats-health-test";
+
+    fty_shm_set_test_dir(".");
+
+    zactor_t* server = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    REQUIRE(server);
+    zstr_sendx(server, "BIND", endpoint, NULL);
+
+    MockAgents mock;
+    mock.endpoint = endpoint;
+    populate(mock);
+
+    zactor_t* agents = zactor_new(mockAgents, &mock);
+    REQUIRE(agents);
+
+    // Tick (and publish health metrics) every 200 ms when idle
+    AlertStatsActorParams params;
+    params.endpoint      = endpoint;
+    params.metricTTL     = 180;
+    params.pollerTimeout = 200;
+    zactor_t* alertStats = zactor_new(fty_alert_stats_server, reinterpret_cast<void*>(&params));
+    REQUIRE(alertStats);
+
+    zstr_send(alertStats, "RESYNC");
+
+    // 1 datacenter + 4 rooms + 16 rows + 64 racks, a WARNING per rack and a CRITICAL per room
+    auto health = [](const char* type) {
+        std::string value;
+        fty::shm::read_metric_value(AlertStatsActor::HEALTH_ASSET, type, value);
+        return value;
+    };
+    for (int i = 0; i < 100 && health(AlertStatsActor::HEALTH_ASSETS) != "85"; i++) {
+        zclock_sleep(100);
+    }
+
+    CHECK(health(AlertStatsActor::HEALTH_ASSETS) == "85");
+    CHECK(health(AlertStatsActor::HEALTH_ALERTS) == "68");
+    // Seconds since the resync completed, bounded by the wait above
+    const std::string resyncAge = health(AlertStatsActor::HEALTH_RESYNC_AGE);
+    REQUIRE(!resyncAge.empty());
+    CHECK(resyncAge.find_first_not_of("0123456789") == std::string::npos);
+    CHECK(std::stoll(resyncAge) <= 10);
+    CHECK(!health(AlertStatsActor::HEALTH_RESYNC_DURATION).empty());
+    CHECK(!health(AlertStatsActor::HEALTH_INGEST_RATE).empty());
+    CHECK(!health(AlertStatsActor::HEALTH_PUBLISH_LAG).empty());
+    CHECK(!health(AlertStatsActor::HEALTH_QUEUE_LAG).empty());
+    CHECK(health(AlertStatsActor::HEALTH_QUEUE_DECODED) == "0");
+    CHECK(!health(AlertStatsActor::HEALTH_QUEUE_WRITER).empty());
+
+    zactor_destroy(&alertStats);
+    zactor_destroy(&agents);
+    zactor_destroy(&server);
+
+    fty_shm_delete_test_dir();
+}
+
+TEST_CASE("alert stats resync with looping paths")
+{
+    const char* endpoint = "inproc://fty-alert-stats-resync-loop-test";
+
+    fty_shm_set_test_dir(".");
+
+    zactor_t* server = zactor_new(mlm_server, const_cast<char*>("Malamute"));
+    REQUIRE(server);
+    zstr_sendx(server, "BIND", endpoint, NULL);
+
+    /**
+     * Stale paths through containers we have no record of: row-8 would be
+     * below rack-8 (its own child), row-9 below itself.
+     */
+    MockAgents mock;
+    mock.endpoint               = endpoint;
+    mock.parents["rack-8"]      = "row-8";
+    mock.paths["rack-8"]        = {"rack-8"};
+    mock.parents["rack-9"]      = "row-9";
+    mock.paths["rack-9"]        = {"row-9"};
+    mock.alerts["alert@rack-8"] = "rack-8";
+    mock.alerts["alert@rack-9"] = "rack-9";
+
+    zactor_t* agents = zactor_new(mockAgents, &mock);
+    REQUIRE(agents);
+
+    AlertStatsActorParams params;
+    params.endpoint      = endpoint;
+    params.metricTTL     = 180;
+    params.pollerTimeout = 720 * 1000;
+    zactor_t* alertStats = zactor_new(fty_alert_stats_server, reinterpret_cast<void*>(&params));
+    REQUIRE(alertStats);
+
+    zstr_send(alertStats, "RESYNC");
+    CHECK(waitMetric("row-8", AlertStatsActor::WARNING_METRIC, "1") == "1");
+    CHECK(waitMetric("row-9", AlertStatsActor::WARNING_METRIC, "1") == "1");
+
+    // Alerts below the containers still propagate, instead of looping forever
+    mlm_client_t* alertsProducer = mlm_client_new();
+    REQUIRE(mlm_client_connect(alertsProducer, endpoint, 1000, "alerts_producer") == 0);
+    REQUIRE(mlm_client_set_producer(alertsProducer, FTY_PROTO_STREAM_ALERTS) == 0);
+
+    for (const char* rack : {"rack-8", "rack-9"}) {
+        zmsg_t* alert = fty_proto_encode_alert(nullptr, uint64_t(zclock_time() / 1000), 600,
+            (std::string("extra@") + rack).c_str(), rack, "ACTIVE", "WARNING", "", nullptr);
+        REQUIRE(mlm_client_send(alertsProducer, "alert", &alert) == 0);
+    }
+
+    CHECK(waitMetric("rack-8", AlertStatsActor::WARNING_METRIC, "2") == "2");
+    CHECK(waitMetric("row-8", AlertStatsActor::WARNING_METRIC, "2") == "2");
+    CHECK(waitMetric("rack-9", AlertStatsActor::WARNING_METRIC, "2") == "2");
+    CHECK(waitMetric("row-9", AlertStatsActor::WARNING_METRIC, "2") == "2");
+
+    mlm_client_destroy(&alertsProducer);
+    zactor_destroy(&alertStats);
+    zactor_destroy(&agents);
+    zactor_destroy(&server);
+
+    fty_shm_delete_test_dir();
+}
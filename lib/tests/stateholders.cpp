@@ -0,0 +1,22 @@
+#include "src/fty_proto_stateholders.h"
+#include <catch2/catch.hpp>
+#include <string>
+
+TEST_CASE("alert state and severity parsing")
+{
+    CHECK(parseAlertState("ACTIVE") == FtyAlertState::ACTIVE);
+    CHECK(parseAlertState("RESOLVED") == FtyAlertState::RESOLVED);
+    CHECK(parseAlertState("ACK-WIP") == FtyAlertState::ACKNOWLEDGED);
+    CHECK(parseAlertState("ACK-SILENCE") == FtyAlertState::ACKNOWLEDGED);
+    CHECK(parseAlertState("BOGUS") == FtyAlertState::UNKNOWN);
+    CHECK(parseAlertState(nullptr) == FtyAlertState::UNKNOWN);
+
+    CHECK(parseAlertSeverity("CRITICAL") == FtyAlertSeverity::CRITICAL);
+    CHECK(parseAlertSeverity("WARNING") == FtyAlertSeverity::WARNING);
+    CHECK(parseAlertSeverity("INFO") == FtyAlertSeverity::INFO);
+    CHECK(parseAlertSeverity("") == FtyAlertSeverity::UNKNOWN);
+    CHECK(parseAlertSeverity(nullptr) == FtyAlertSeverity::UNKNOWN);
+
+    CHECK(std::string(alertStateName(FtyAlertState::ACKNOWLEDGED)) == "ACKNOWLEDGED");
+    CHECK(std::string(alertSeverityName(FtyAlertSeverity::WARNING)) == "WARNING");
+}
@@ -0,0 +1,74 @@
+#include "src/fty_alert_stats_topology.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("alert counters")
+{
+    AlertCounters a;
+    AlertCounters b;
+    CHECK(a.empty());
+
+    a[AlertCategory::ACTIVE_CRITICAL]      = 2;
+    a[AlertCategory::ACKNOWLEDGED_WARNING] = 1;
+    b[AlertCategory::ACTIVE_INFO]          = 3;
+    b[AlertCategory::ACKNOWLEDGED_WARNING] = 1;
+
+    a += b;
+    CHECK(a.str() == "(2 0 3 0 2 0)");
+    a -= b;
+    CHECK(a.str() == "(2 0 0 0 1 0)");
+    CHECK(!a.empty());
+
+    const AlertCategories acknowledged = alertCategoryBit(AlertCategory::ACKNOWLEDGED_CRITICAL) |
+                                         alertCategoryBit(AlertCategory::ACKNOWLEDGED_WARNING) |
+                                         alertCategoryBit(AlertCategory::ACKNOWLEDGED_INFO);
+    CHECK(a.sum(acknowledged) == 1);
+    CHECK(a.equal(b, acknowledged));
+    CHECK(!a.equal(b, alertCategoryBit(AlertCategory::ACTIVE_CRITICAL)));
+
+    AlertPublication publication;
+    CHECK(publication.changed(a, acknowledged));
+    publication.sent      = b;
+    publication.published = true;
+    CHECK(!publication.changed(a, acknowledged));
+    CHECK(publication.changed(a, alertCategoryBit(AlertCategory::ACTIVE_INFO)));
+}
+
+TEST_CASE("alert metric parsing")
+{
+    CHECK(parseAlertCategory("acknowledged.info") == AlertCategory::ACKNOWLEDGED_INFO);
+    CHECK(parseAlertCategory("bogus") == AlertCategory::COUNT);
+    CHECK(std::string(alertCategoryName(AlertCategory::ACTIVE_WARNING)) == "active.warning");
+
+    AlertMetric metric;
+    CHECK(parseAlertMetric("alerts.warning", "active.warning, acknowledged.warning", metric));
+    CHECK(metric.name == "alerts.warning");
+    CHECK(metric.categories ==
+          (alertCategoryBit(AlertCategory::ACTIVE_WARNING) | alertCategoryBit(AlertCategory::ACKNOWLEDGED_WARNING)));
+
+    CHECK(!parseAlertMetric("alerts.warning", "active.warning,bogus", metric));
+    CHECK(!parseAlertMetric("alerts.warning", "", metric));
+    CHECK(!parseAlertMetric("", "active.warning", metric));
+
+    AlertMetrics metrics = defaultAlertMetrics();
+    REQUIRE(metrics.size() == 2);
+    CHECK(metrics[0].name == "alerts.active.warning");
+    CHECK(metrics[1].name == "alerts.active.critical");
+}
+
+TEST_CASE("topology aggregation")
+{
+    AssetTopology     topology;
+    AssetTopology::Id datacenter = topology.intern("datacenter-1");
+    AssetTopology::Id room       = topology.intern("room-1");
+    AssetTopology::Id rack       = topology.intern("rack-1");
+    topology.setParent(room, datacenter);
+    topology.setParent(rack, room);
+
+    topology.counters(rack)[AlertCategory::ACTIVE_WARNING]       = 1;
+    topology.counters(room)[AlertCategory::ACKNOWLEDGED_CRITICAL] = 1;
+    topology.aggregate();
+
+    CHECK(topology.counters(datacenter).str() == "(0 1 0 1 0 0)");
+    CHECK(topology.counters(room).str() == "(0 1 0 1 0 0)");
+    CHECK(topology.counters(rack).str() == "(0 1 0 0 0 0)");
+}
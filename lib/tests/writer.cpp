@@ -0,0 +1,60 @@
+#include "src/fty_alert_stats_writer.h"
+#include <catch2/catch.hpp>
+#include <fty_shm.h>
+
+TEST_CASE("metric writer")
+{
+    fty_shm_set_test_dir(".");
+
+    {
+        // A tiny queue, so that writers wait on the writer thread
+        MetricWriter writer(2);
+
+        for (int i = 0; i < 10; i++) {
+            writer.write("rack-" + std::to_string(i), "alerts.active.warning", std::to_string(i), "", 60);
+        }
+        writer.flush();
+
+        CHECK(writer.writes() == 10);
+        CHECK(writer.failures() == 0);
+
+        std::string value;
+        REQUIRE(fty::shm::read_metric_value("rack-7", "alerts.active.warning", value) == 0);
+        CHECK(value == "7");
+
+        // Pending writes are done on destruction
+        writer.write("rack-7", "alerts.active.warning", "8", "", 60);
+    }
+
+    std::string value;
+    REQUIRE(fty::shm::read_metric_value("rack-7", "alerts.active.warning", value) == 0);
+    CHECK(value == "8");
+
+    fty_shm_delete_test_dir();
+}
+
+TEST_CASE("metric writer supersedes pending values")
+{
+    fty_shm_set_test_dir(".");
+
+    {
+        MetricWriter writer;
+
+        for (int i = 0; i < 1000; i++) {
+            writer.write("rack-1", "alerts.active.warning", std::to_string(i), "", 60);
+        }
+        writer.flush();
+
+        // Every value is either written or superseded by a newer one
+        CHECK(writer.writes() + writer.superseded() == 1000);
+        CHECK(writer.depth() == 0);
+        CHECK(writer.maxDepth() == 1);
+        CHECK(writer.latency().count() == writer.writes());
+
+        std::string value;
+        REQUIRE(fty::shm::read_metric_value("rack-1", "alerts.active.warning", value) == 0);
+        CHECK(value == "999");
+    }
+
+    fty_shm_delete_test_dir();
+}